@@ -3,6 +3,45 @@
 #include <vector>
 #include <algorithm>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <climits>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <array>
+#include <iomanip>
+#include <cmath>
+#include <shared_mutex>
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <random>
 
 using namespace std;
 
@@ -21,458 +60,7219 @@ public:
     }
 };
 
-// Observer Design Pattern
-class IObserver {
+class SeatUnavailableException : public BookingException {
 public:
-    virtual void update(const string& message) = 0;
+    virtual const char* what() const throw() {
+        return "Seat not available";
+    }
 };
 
-class ISubject {
+class InvalidFlightTimeException : public BookingException {
 public:
-    virtual void attach(IObserver* observer) = 0;
-    virtual void detach(IObserver* observer) = 0;
-    virtual void notify(const string& message) = 0;
+    virtual const char* what() const throw() {
+        return "Invalid flight time";
+    }
 };
 
-// Base class for Person
-class Person {
-protected:
-    string name;
-    string email;
-    string phone_number;
-
+class InvalidStatusTransitionException : public BookingException {
 public:
-    // Constructor to initialize a person's details
-    Person(const string& name, const string& email, const string& phone_number)
-        : name(name), email(email), phone_number(phone_number) {}
+    virtual const char* what() const throw() {
+        return "Booking status cannot change that way";
+    }
+};
 
-    // Method to display person's details
-    virtual void get_details() const {
-        cout << "Name: " << name << ", Email: " << email << ", Phone Number: " << phone_number << endl;
+class SnapshotException : public exception {
+public:
+    virtual const char* what() const throw() {
+        return "Invalid or unreadable snapshot file";
     }
+};
 
-    string get_name() const {
-        return name;
+class JournalException : public exception {
+public:
+    virtual const char* what() const throw() {
+        return "Cannot write booking journal";
     }
+};
 
-    void set_email(const string& new_email) {
-        email = new_email;
+// Parse a "YYYY-MM-DD HH:MM" timestamp into minutes since 1970-01-01 00:00; false for times outside int32 minutes
+bool parse_timestamp(string_view text, int32_t& minutes) {
+    // Read a run of 1 to max_digits digits followed by the separator (or the end when separator is 0)
+    size_t position = 0;
+    auto read_field = [&text, &position](size_t max_digits, char separator, int& value) {
+        size_t start = position;
+        value = 0;
+        while (position < text.size() && position - start < max_digits && text[position] >= '0' && text[position] <= '9') {
+            value = value * 10 + (text[position++] - '0');
+        }
+        if (position == start) {
+            return false;
+        }
+        if (separator == 0) {
+            return position == text.size();
+        }
+        return position < text.size() && text[position++] == separator;
+    };
+    int year, month, day, hour, minute;
+    if (!read_field(4, '-', year) || !read_field(2, '-', month) || !read_field(2, ' ', day) ||
+        !read_field(2, ':', hour) || !read_field(2, 0, minute)) {
+        return false;
     }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    // Days from civil date (proleptic Gregorian calendar)
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int year_of_era = y - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int64_t days = static_cast<int64_t>(era) * 146097 + day_of_era - 719468;
+    int64_t total = days * 1440 + hour * 60 + minute;
+    if (total < INT32_MIN || total > INT32_MAX) {
+        return false;
+    }
+    minutes = static_cast<int32_t>(total);
+    return true;
+}
 
-    void set_phone_number(const string& new_phone_number) {
-        phone_number = new_phone_number;
+// Day number (days since 1970-01-01) of a time in minutes since 1970-01-01 00:00
+int32_t day_of(int32_t minutes) {
+    return minutes / 1440 - (minutes % 1440 < 0 ? 1 : 0);
+}
+
+// Render a day number and a minute of that day as "YYYY-MM-DD HH:MM"
+string format_day_minute(int64_t days, int minute_of_day) {
+    // Civil date from days (proleptic Gregorian calendar)
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int day_of_era = static_cast<int>(days - era * 146097);
+    int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int mp = (5 * day_of_year + 2) / 153;
+    int day = day_of_year - (153 * mp + 2) / 5 + 1;
+    int month = mp < 10 ? mp + 3 : mp - 9;
+    int year = static_cast<int>(year_of_era + era * 400) + (month <= 2 ? 1 : 0);
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d", year, month, day, minute_of_day / 60, minute_of_day % 60);
+    return buffer;
+}
+
+// Render minutes since 1970-01-01 00:00 as "YYYY-MM-DD HH:MM"
+string format_timestamp(int32_t minutes) {
+    int32_t day = day_of(minutes);
+    return format_day_minute(day, static_cast<int>(minutes - static_cast<int64_t>(day) * 1440));
+}
+
+// First and last day numbers whose every minute fits in int32 minutes
+const int32_t first_whole_day = INT32_MIN / 1440;
+const int32_t last_whole_day = (INT32_MAX - 1439) / 1440;
+
+// Parse a "YYYY-MM-DD" date into a day number. Only whole days are accepted, so day * 1440 and (day + 1) * 1440
+// are both valid times for the range queries that take a date.
+bool parse_date(string_view text, int32_t& day) {
+    int32_t minutes;
+    if (!parse_timestamp(string(text) + " 00:00", minutes) || day_of(minutes) < first_whole_day ||
+        day_of(minutes) > last_whole_day) {
+        return false;
     }
+    day = day_of(minutes);
+    return true;
+}
+
+// Render a day number as "YYYY-MM-DD"; the date is computed from the day itself, so any day number is valid
+string format_date(int32_t day) {
+    return format_day_minute(day, 0).substr(0, 10);
+}
+
+// Hot-path instrumentation, compiled in with -DFLIGHT_SYSTEM_INSTRUMENTATION=1. A probe times its scope into a
+// log-linear latency histogram and counts the heap allocations made inside it. Each thread records into its own
+// counters and a dump merges them, so probes on different threads never share a cache line. Without the flag
+// INSTRUMENT_SCOPE expands to nothing and operator new is not replaced.
+#ifndef FLIGHT_SYSTEM_INSTRUMENTATION
+#define FLIGHT_SYSTEM_INSTRUMENTATION 0
+#endif
+
+#if FLIGHT_SYSTEM_INSTRUMENTATION
+
+// Operations with a probe; values index the per-thread counters
+enum class Probe : uint8_t {
+    FindFlight,
+    CreateBooking,
+    ConfirmBooking,
+    CancelBooking,
+    Notify,
+    Deliver,
+    ServerRequest,
+    Count
 };
 
-// Passenger class inheriting Person and implementing IObserver
-class Passenger : public Person, public IObserver {
-private:
-    string passport_number;
+const char* probe_name(Probe probe) {
+    switch (probe) {
+    case Probe::FindFlight: return "FindFlight";
+    case Probe::CreateBooking: return "CreateBooking";
+    case Probe::ConfirmBooking: return "ConfirmBooking";
+    case Probe::CancelBooking: return "CancelBooking";
+    case Probe::Notify: return "Notify";
+    case Probe::Deliver: return "Deliver";
+    case Probe::ServerRequest: return "ServerRequest";
+    case Probe::Count: break;
+    }
+    return "Unknown";
+}
 
-public:
-    // Constructor to initialize a passenger's details
-    Passenger(const string& name, const string& email, const string& phone_number, const string& passport_number)
-        : Person(name, email, phone_number), passport_number(passport_number) {}
+const size_t probe_count = static_cast<size_t>(Probe::Count);
 
-    // Method to display passenger's details
-    void get_passenger_info() const {
-        get_details();
-        cout << "Passport Number: " << passport_number << endl;
+// Bucketing of an HDR-style histogram of nanoseconds. Values below 2 * sub_bucket_count have a bucket each;
+// above that each power of two is split into sub_bucket_count buckets, so a reported value is within
+// 1 / sub_bucket_count of the true one. Values are capped at 2^40 ns, about 18 minutes.
+struct LatencyBuckets {
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr unsigned sub_bucket_count = 1u << sub_bucket_bits;
+    static constexpr unsigned max_value_bits = 40;
+    static constexpr size_t count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+    static size_t index_of(uint64_t value) {
+        value = min(value, (uint64_t(1) << max_value_bits) - 1);
+        if (value < 2 * sub_bucket_count) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = 63 - __builtin_clzll(value) - sub_bucket_bits;
+        return (shift + 1) * sub_bucket_count + static_cast<size_t>((value >> shift) - sub_bucket_count);
     }
 
-    // Method to receive updates
-    void update(const string& message) override {
-        cout << "Passenger received update: " << message << endl;
+    // Highest value that falls in a bucket
+    static uint64_t highest_in(size_t index) {
+        if (index < 2 * sub_bucket_count) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>(index / sub_bucket_count) - 1;
+        return ((sub_bucket_count + index % sub_bucket_count + 1) << shift) - 1;
     }
+};
 
-    string get_passport_number() const {
-        return passport_number;
+// Counters of one thread. Only the owning thread writes them, so increments are a relaxed load and store
+// rather than a locked read-modify-write; a concurrent dump may see a count one behind.
+struct ThreadProbes {
+    atomic<uint64_t> latency_counts[probe_count][LatencyBuckets::count];
+    atomic<uint64_t> total_ns[probe_count];
+    atomic<uint64_t> max_ns[probe_count];
+    atomic<uint64_t> scope_allocations[probe_count]; // Allocations made inside each probe's scopes
+    atomic<uint64_t> allocations;
+    atomic<uint64_t> allocated_bytes;
+
+    static void add(atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    void record(Probe probe, uint64_t nanoseconds, uint64_t scope_allocation_count) {
+        size_t p = static_cast<size_t>(probe);
+        add(latency_counts[p][LatencyBuckets::index_of(nanoseconds)], 1);
+        add(total_ns[p], nanoseconds);
+        if (nanoseconds > max_ns[p].load(memory_order_relaxed)) {
+            max_ns[p].store(nanoseconds, memory_order_relaxed);
+        }
+        add(scope_allocations[p], scope_allocation_count);
     }
 };
 
-// Abstract Flight class implementing ISubject
-class Flight : public ISubject {
-protected:
-    string flight_number;
-    string origin;
-    string destination;
-    string departure_time;
-    string arrival_time;
-    vector<IObserver*> observers;
+// Instrumentation class keeping every thread's counters. A thread's counters are created on its first probe
+// and kept after it exits, so a dump covers finished threads too.
+class Instrumentation {
+private:
+    mutex registry_mutex;
+    vector<ThreadProbes*> threads;
 
-public:
-    // Constructor to initialize flight details
-    Flight(const string& flight_number, const string& origin, const string& destination, const string& departure_time, const string& arrival_time)
-        : flight_number(flight_number), origin(origin), destination(destination), departure_time(departure_time), arrival_time(arrival_time) {}
+    static inline thread_local ThreadProbes* current = nullptr;
+    // Allocations on threads that have not reached a probe yet
+    static inline atomic<uint64_t> unattributed_allocations{ 0 };
+    static inline atomic<uint64_t> unattributed_bytes{ 0 };
 
-    // Method to display flight details
-    virtual void get_flight_info() const {
-        cout << "Flight Number: " << flight_number << ", Origin: " << origin << ", Destination: " << destination
-            << ", Departure Time: " << departure_time << ", Arrival Time: " << arrival_time << endl;
+    Instrumentation() = default;
+
+    ThreadProbes* register_thread() {
+        ThreadProbes* probes = new ThreadProbes();
+        lock_guard<mutex> lock(registry_mutex);
+        threads.push_back(probes);
+        return probes;
     }
 
-    // Pure virtual methods for availability and fare calculation
-    virtual bool check_availability() const = 0;
-    virtual double calculate_fare() const = 0;
+public:
+    Instrumentation(const Instrumentation&) = delete;
+    Instrumentation& operator=(const Instrumentation&) = delete;
 
-    // Attach an observer
-    void attach(IObserver* observer) override {
-        observers.push_back(observer);
+    static Instrumentation& instance() {
+        static Instrumentation instrumentation;
+        return instrumentation;
     }
 
-    // Detach an observer
-    void detach(IObserver* observer) override {
-        observers.erase(remove(observers.begin(), observers.end(), observer), observers.end());
+    // The calling thread's counters
+    static ThreadProbes& probes() {
+        if (!current) {
+            current = instance().register_thread();
+        }
+        return *current;
     }
 
-    // Notify all observers
-    void notify(const string& message) override {
-        for (auto* observer : observers) {
-            observer->update(message);
+    // Count a heap allocation; called from operator new, so it must not allocate
+    static void count_allocation(size_t size) {
+        ThreadProbes* probes = current;
+        if (probes) {
+            ThreadProbes::add(probes->allocations, 1);
+            ThreadProbes::add(probes->allocated_bytes, size);
+        } else {
+            unattributed_allocations.fetch_add(1, memory_order_relaxed);
+            unattributed_bytes.fetch_add(size, memory_order_relaxed);
         }
     }
 
-    string get_origin() const { return origin; }
-    string get_destination() const { return destination; }
-    string get_flight_number() const { return flight_number; }
+    // Merge every thread's counters and display count, mean and percentiles per probe, then allocation totals
+    void dump() {
+        lock_guard<mutex> lock(registry_mutex);
+        vector<uint64_t> merged(LatencyBuckets::count);
+        ios_base::fmtflags flags = cout.flags();
+        streamsize precision = cout.precision(3);
+        cout << fixed;
+        cout << left << setw(16) << "Probe" << right << setw(12) << "Count" << setw(12) << "Mean us" << setw(10) << "p50 us"
+            << setw(10) << "p99 us" << setw(10) << "p99.9 us" << setw(10) << "Max us" << setw(12) << "Allocs/op" << endl;
+        for (size_t p = 0; p < probe_count; ++p) {
+            fill(merged.begin(), merged.end(), 0);
+            uint64_t count = 0, total_ns = 0, max_ns = 0, allocations = 0;
+            for (const auto* probes : threads) {
+                for (size_t b = 0; b < LatencyBuckets::count; ++b) {
+                    uint64_t bucket = probes->latency_counts[p][b].load(memory_order_relaxed);
+                    merged[b] += bucket;
+                    count += bucket;
+                }
+                total_ns += probes->total_ns[p].load(memory_order_relaxed);
+                max_ns = max(max_ns, probes->max_ns[p].load(memory_order_relaxed));
+                allocations += probes->scope_allocations[p].load(memory_order_relaxed);
+            }
+            if (!count) {
+                continue;
+            }
+            // The value below which a fraction of the samples fall: the highest value of its bucket, or the maximum
+            auto percentile = [&merged, count, max_ns](double fraction) {
+                uint64_t rank = static_cast<uint64_t>(fraction * count), seen = 0;
+                size_t b = 0;
+                while (b + 1 < merged.size() && (seen += merged[b]) <= rank) {
+                    ++b;
+                }
+                return min(LatencyBuckets::highest_in(b), max_ns) / 1000.0;
+            };
+            cout << left << setw(16) << probe_name(static_cast<Probe>(p)) << right << setw(12) << count
+                << setw(12) << total_ns / 1000.0 / count << setw(10) << percentile(0.5) << setw(10) << percentile(0.99)
+                << setw(10) << percentile(0.999) << setw(10) << max_ns / 1000.0 << setw(12) << double(allocations) / count << endl;
+        }
+        uint64_t unattributed = unattributed_allocations.load(memory_order_relaxed);
+        uint64_t allocations = unattributed;
+        uint64_t bytes = unattributed_bytes.load(memory_order_relaxed);
+        for (const auto* probes : threads) {
+            allocations += probes->allocations.load(memory_order_relaxed);
+            bytes += probes->allocated_bytes.load(memory_order_relaxed);
+        }
+        cout << "Heap allocations: " << allocations << " (" << bytes / (1024.0 * 1024.0) << " MB), " << unattributed
+            << " of them on threads before their first probe; instrumented threads: " << threads.size() << endl;
+        cout.flags(flags);
+        cout.precision(precision);
+    }
 };
 
-// DomesticFlight class inheriting Flight
-class DomesticFlight : public Flight {
+// ProbeScope class recording the time and allocations from its construction to its destruction
+class ProbeScope {
+private:
+    ThreadProbes& probes;
+    Probe probe;
+    uint64_t allocations_at_start;
+    chrono::steady_clock::time_point started;
+
 public:
-    // Constructor to initialize domestic flight details
-    DomesticFlight(const string& flight_number, const string& origin, const string& destination, const string& departure_time, const string& arrival_time)
-        : Flight(flight_number, origin, destination, departure_time, arrival_time) {}
+    explicit ProbeScope(Probe probe)
+        : probes(Instrumentation::probes()), probe(probe), allocations_at_start(probes.allocations.load(memory_order_relaxed)),
+          started(chrono::steady_clock::now()) {}
+    ProbeScope(const ProbeScope&) = delete;
+    ProbeScope& operator=(const ProbeScope&) = delete;
 
-    // Method to check availability
-    bool check_availability() const override {
-        return true; // Simplified for demonstration
+    ~ProbeScope() {
+        uint64_t elapsed = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count());
+        probes.record(probe, elapsed, probes.allocations.load(memory_order_relaxed) - allocations_at_start);
     }
+};
 
-    // Method to calculate fare
-    double calculate_fare() const override {
-        double base_fare = 50.0; // Base fare for domestic flights
-        return base_fare;
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_SCOPE(probe) ProbeScope INSTRUMENT_CONCAT(probe_scope_, __LINE__)(probe)
+
+// Count every heap allocation
+void* operator new(size_t size) {
+    Instrumentation::count_allocation(size);
+    void* memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw bad_alloc();
     }
-};
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// Kept out of line: inlined into callers, GCC would warn that memory from new is passed to free
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+// Display the instrumentation counters
+void dump_instrumentation() {
+    Instrumentation::instance().dump();
+}
+
+#else
+
+#define INSTRUMENT_SCOPE(probe) ((void)0)
+
+void dump_instrumentation() {
+    cout << "Instrumentation is compiled out; build with -DFLIGHT_SYSTEM_INSTRUMENTATION=1 to enable it" << endl;
+}
+
+#endif
+
+// Small integer id standing for an interned string
+typedef uint32_t Symbol;
+
+// SymbolTable class interning airport names and flight numbers as small integer ids
+class SymbolTable {
+private:
+    // std::deque never moves its elements, so the string_view keys below stay valid
+    deque<string> names;
+    unordered_map<string_view, Symbol> ids;
+
+    SymbolTable() = default;
 
-// InternationalFlight class inheriting Flight
-class InternationalFlight : public Flight {
 public:
-    // Constructor to initialize international flight details
-    InternationalFlight(const string& flight_number, const string& origin, const string& destination, const string& departure_time, const string& arrival_time)
-        : Flight(flight_number, origin, destination, departure_time, arrival_time) {}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
 
-    // Method to check availability
-    bool check_availability() const override {
-        return true; // Simplified for demonstration
+    // The process-wide table shared by flights, schedules and their indexes
+    static SymbolTable& instance() {
+        static SymbolTable table;
+        return table;
     }
 
-    // Method to calculate fare
-    double calculate_fare() const override {
-        double base_fare = 200.0; // Base fare for international flights
-        return base_fare;
+    // Return the id for a string, assigning the next id on first sight
+    Symbol intern(string_view text) {
+        auto it = ids.find(text);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        Symbol symbol = static_cast<Symbol>(names.size());
+        names.emplace_back(text);
+        ids.emplace(names.back(), symbol);
+        return symbol;
     }
-};
 
-// FlightFactory class for creating flight instances
-class FlightFactory {
-public:
-    // Static method to create flight instances based on flight type
-    static Flight* create_flight(const string& flight_type, const string& flight_number, const string& origin, const string& destination, const string& departure_time, const string& arrival_time) {
-        if (flight_type == "Domestic") {
-            return new DomesticFlight(flight_number, origin, destination, departure_time, arrival_time);
-        } else if (flight_type == "International") {
-            return new InternationalFlight(flight_number, origin, destination, departure_time, arrival_time);
+    // Look up a string without interning it
+    bool find(string_view text, Symbol& symbol) const {
+        auto it = ids.find(text);
+        if (it == ids.end()) {
+            return false;
         }
-        return nullptr;
+        symbol = it->second;
+        return true;
+    }
+
+    const string& name(Symbol symbol) const {
+        return names[symbol];
+    }
+
+    size_t size() const {
+        return names.size();
     }
 };
 
-// Booking class to manage flight bookings
-class Booking {
-private:
-    string booking_id;
-    Passenger* passenger;
-    Flight* flight;
-    string seat_number;
-    string booking_status;
+// Stable reference to a passenger owned by a PassengerRegistry
+struct PassengerHandle {
+    static constexpr uint32_t invalid_index = UINT32_MAX;
+    uint32_t index = invalid_index;
 
-public:
-    // Constructor to initialize booking details
-    Booking(const string& booking_id, Passenger* passenger, Flight* flight, const string& seat_number, const string& booking_status)
-        : booking_id(booking_id), passenger(passenger), flight(flight), seat_number(seat_number), booking_status(booking_status) {}
+    bool is_valid() const { return index != invalid_index; }
+};
 
-    // Method to confirm booking
-    void confirm_booking() {
-        booking_status = "Confirmed";
-        flight->notify("Booking confirmed for flight " + flight->get_origin() + " to " + flight->get_destination() + " for passenger " + passenger->get_name());
-    }
+// Lifecycle states of a booking
+enum class BookingStatus : uint8_t {
+    Pending,
+    Confirmed,
+    Cancelled
+};
 
-    // Method to cancel booking
-    void cancel_booking() {
-        booking_status = "Cancelled";
-        flight->notify("Booking cancelled for flight " + flight->get_origin() + " to " + flight->get_destination() + " for passenger " + passenger->get_name());
+const char* booking_status_name(BookingStatus status) {
+    switch (status) {
+    case BookingStatus::Pending:
+        return "Pending";
+    case BookingStatus::Confirmed:
+        return "Confirmed";
+    case BookingStatus::Cancelled:
+        return "Cancelled";
     }
+    return "Unknown";
+}
 
-    // Get flight associated with the booking
-    Flight* get_flight() const {
-        return flight;
-    }
+// Whether a booking may move between two states. A booking is created in any state, then only moves forward:
+//   Pending -> Confirmed, Pending -> Cancelled, Confirmed -> Cancelled
+// Cancelled is final.
+bool booking_status_can_change(BookingStatus from, BookingStatus to) {
+    return (from == BookingStatus::Pending && to != BookingStatus::Pending) ||
+           (from == BookingStatus::Confirmed && to == BookingStatus::Cancelled);
+}
 
-    // Get booking status
-    string get_booking_status() const {
-        return booking_status;
-    }
+// Booking counts by status and the revenue of the confirmed ones, for one flight or a roll-up of flights
+struct BookingTotals {
+    uint32_t bookings[3] = { 0, 0, 0 }; // Indexed by BookingStatus
+    double revenue = 0.0;
 
-    // Set booking status and notify observers
-    void set_booking_status(const string& status) {
-        booking_status = status;
-        flight->notify("Booking status changed for flight " + flight->get_origin() + " to " + flight->get_destination() + " for passenger " + passenger->get_name() + " to " + status);
+    // Add (delta 1) or remove (delta -1) a booking in a status, whose seat sells for fare
+    void count(BookingStatus status, double fare, int delta) {
+        bookings[static_cast<size_t>(status)] += delta;
+        if (status == BookingStatus::Confirmed) {
+            revenue += fare * delta;
+        }
     }
 
-    // Display booking details
-    void get_booking_info() const {
-        cout << "Booking ID: " << booking_id << ", Seat Number: " << seat_number << ", Status: " << booking_status << endl;
-        flight->get_flight_info();
+    void add(const BookingTotals& other, int sign) {
+        for (size_t i = 0; i < 3; ++i) {
+            bookings[i] += sign * static_cast<int64_t>(other.bookings[i]);
+        }
+        revenue += sign * other.revenue;
     }
 
-    // Get booking ID
-    string get_booking_id() const {
-        return booking_id;
+    uint32_t get_bookings(BookingStatus status) const { return bookings[static_cast<size_t>(status)]; }
+    uint32_t get_seats_sold() const { return get_bookings(BookingStatus::Confirmed); }
+    bool empty() const { return bookings[0] == 0 && bookings[1] == 0 && bookings[2] == 0; }
+
+    // Equal counts and revenue. Base fares are whole amounts, so revenue sums are exact in any order.
+    bool matches(const BookingTotals& other) const {
+        return bookings[0] == other.bookings[0] && bookings[1] == other.bookings[1] && bookings[2] == other.bookings[2] &&
+               revenue == other.revenue;
     }
 
-    Passenger* get_passenger() const {
-        return passenger;
+    void append_totals(string& out) const {
+        char revenue_text[32];
+        snprintf(revenue_text, sizeof(revenue_text), "%.2f", revenue);
+        out += "Pending: ";
+        out += to_string(get_bookings(BookingStatus::Pending));
+        out += ", Confirmed: ";
+        out += to_string(get_bookings(BookingStatus::Confirmed));
+        out += ", Cancelled: ";
+        out += to_string(get_bookings(BookingStatus::Cancelled));
+        out += ", Seats sold: ";
+        out += to_string(get_seats_sold());
+        out += ", Revenue: ";
+        out += revenue_text;
+        out += '\n';
     }
 };
 
-// Itinerary class to manage bookings for a passenger
-class Itinerary {
+// Kinds of event a flight publishes to its observers
+enum class EventKind : uint8_t {
+    BookingConfirmed,
+    BookingCancelled,
+    BookingStatusChanged,
+    Announcement
+};
+
+// Structured flight event; it holds ids only and is turned into text by sinks that need it
+// Names are resolved when the event is built, on the publishing thread, so the dispatcher thread never reads
+// the symbol table or the passenger registry while they change. They view SymbolTable strings and passenger
+// names, which never move or change.
+struct FlightEvent {
+    EventKind kind;
+    BookingStatus status;
+    string_view flight_number;
+    string_view origin;
+    string_view destination;
+    string_view passenger_name;
+    const char* text; // Announcement text; must outlive delivery, e.g. a string literal
+};
+
+// Observer Design Pattern
+class IObserver {
+public:
+    virtual void update(const FlightEvent& event) = 0;
+};
+
+class ISubject {
+public:
+    virtual void attach(IObserver* observer) = 0;
+    virtual void detach(IObserver* observer) = 0;
+    // Publish an event; delivery may happen later on the dispatcher thread
+    virtual void notify(const FlightEvent& event) = 0;
+    // Hand an event to every attached observer now
+    virtual void deliver(const FlightEvent& event) = 0;
+};
+
+// Destination for notifications; implementations buffer writes until flush
+class INotificationSink {
+public:
+    virtual ~INotificationSink() {}
+    virtual void write(const FlightEvent& event) = 0;
+    virtual void flush() = 0;
+};
+
+// Bounded lock-free queue for many producers and one consumer.
+// Each cell carries a sequence number telling producers and the consumer whose turn it is.
+template <typename T>
+class BoundedMpscQueue {
 private:
-    string itinerary_id;
-    vector<Booking*> bookings;
+    struct Cell {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    atomic<size_t> enqueue_position;
+    atomic<size_t> dequeue_position;
 
 public:
-    // Constructor to initialize itinerary details
-    Itinerary(const string& itinerary_id) : itinerary_id(itinerary_id) {}
+    // Capacity must be a power of two
+    explicit BoundedMpscQueue(size_t capacity)
+        : cells(new Cell[capacity]), mask(capacity - 1), enqueue_position(0), dequeue_position(0) {
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
 
-    // Method to display itinerary details
-    void get_itinerary_details() const {
-        cout << "Itinerary ID: " << itinerary_id << endl;
-        for (const auto& booking : bookings) {
-            booking->get_booking_info();
+    // Add an item, returning false if the queue is full
+    bool try_push(T&& value) {
+        size_t position = enqueue_position.load(memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueue_position.load(memory_order_relaxed);
+            }
         }
+        cell->value = move(value);
+        cell->sequence.store(position + 1, memory_order_release);
+        return true;
     }
 
-    // Add booking to itinerary
-    void add_booking(Booking* booking) {
-        bookings.push_back(booking);
+    // Take the oldest item, returning false if the queue is empty; consumer thread only
+    bool try_pop(T& value) {
+        size_t position = dequeue_position.load(memory_order_relaxed);
+        Cell& cell = cells[position & mask];
+        if (cell.sequence.load(memory_order_acquire) != position + 1) {
+            return false;
+        }
+        value = move(cell.value);
+        cell.sequence.store(position + mask + 1, memory_order_release);
+        dequeue_position.store(position + 1, memory_order_relaxed);
+        return true;
     }
 
-    // Remove booking from itinerary
-    void remove_booking(Booking* booking) {
-        bookings.erase(remove(bookings.begin(), bookings.end(), booking), bookings.end());
+    // Number of queued items; approximate while producers are active
+    size_t size() const {
+        return enqueue_position.load(memory_order_relaxed) - dequeue_position.load(memory_order_relaxed);
     }
 };
 
-// Schedule class to manage flights on a specific date
-class Schedule {
+// Typed object pool: objects are carved from fixed-size blocks and freed slots are reused
+// through a freelist, so creating and destroying objects does not go to the general heap.
+template <typename T, size_t BlockSize = 256>
+class ObjectPool {
 private:
-    string schedule_id;
-    string date;
-    vector<Flight*> flights;
+    // A free node links to the next free node; a used node holds a T
+    union Node {
+        Node* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
 
-public:
-    // Constructor to initialize schedule details
-    Schedule(const string& schedule_id, const string& date)
-        : schedule_id(schedule_id), date(date) {}
+    vector<unique_ptr<Node[]>> blocks;
+    Node* free_list = nullptr;
+    size_t unused_in_block = 0; // Never-used nodes left at the end of the newest block
+    size_t live_count = 0;
 
-    // Add flight to schedule
-    void add_flight(Flight* flight) {
-        flights.push_back(flight);
+    Node* allocate() {
+        if (free_list) {
+            Node* node = free_list;
+            free_list = node->next;
+            return node;
+        }
+        if (unused_in_block == 0) {
+            blocks.emplace_back(new Node[BlockSize]);
+            unused_in_block = BlockSize;
+        }
+        return &blocks.back()[BlockSize - unused_in_block--];
     }
 
-    // Remove flight from schedule
-    void remove_flight(Flight* flight) {
-        flights.erase(remove(flights.begin(), flights.end(), flight), flights.end());
+    void release(Node* node) {
+        node->next = free_list;
+        free_list = node;
     }
 
-    // Display schedule details
-    void get_schedule_details() const {
-        cout << "Schedule ID: " << schedule_id << ", Date: " << date << endl;
-        for (const auto& flight : flights) {
-            flight->get_flight_info();
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Construct an object in a pooled slot; the slot is returned if the constructor throws
+    template <typename... Args>
+    T* create(Args&&... args) {
+        Node* node = allocate();
+        try {
+            T* object = new (node->storage) T(std::forward<Args>(args)...);
+            ++live_count;
+            return object;
+        } catch (...) {
+            release(node);
+            throw;
         }
     }
 
-    vector<Flight*> get_flights() const {
-        return flights;
+    // Destroy an object created by this pool and recycle its slot
+    void destroy(T* object) {
+        object->~T();
+        release(reinterpret_cast<Node*>(object));
+        --live_count;
+    }
+
+    size_t size() const {
+        return live_count;
     }
 };
 
-// Function to find a flight by flight number in a schedule
-Flight* find_flight_by_number(Schedule& schedule, const string& flight_number) {
-    for (const auto& flight : schedule.get_flights()) {
-        if (flight->get_flight_number() == flight_number) {
-            return flight;
+// Epoch-based reclamation for data published to lock-free readers. A reader pins the current epoch in its
+// thread's slot for the length of an EpochGuard. A writer first unpublishes an object, then retires it, which
+// advances the epoch; the object is freed once no reader is pinned at or before the epoch it was retired in.
+// Readers that pin after the retirement can no longer reach it, so they never hold up its reclamation.
+class EpochManager {
+private:
+    // One reader slot per thread, on its own cache line; 0 while the thread is not reading
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch{ 0 };
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        function<void()> reclaim;
+    };
+
+    atomic<uint64_t> global_epoch;
+    mutex slots_mutex;
+    deque<ReaderSlot> slots; // Slots never move, and outlive their threads
+    mutex retired_mutex;
+    vector<Retired> retired;
+
+    static inline thread_local ReaderSlot* slot = nullptr;
+    static inline thread_local uint32_t depth = 0; // Nesting of guards on this thread
+
+    EpochManager() : global_epoch(1) {}
+
+    ReaderSlot& thread_slot() {
+        if (!slot) {
+            lock_guard<mutex> lock(slots_mutex);
+            slots.emplace_back();
+            slot = &slots.back();
         }
+        return *slot;
     }
-    throw FlightNotFoundException();
-}
 
-// Function to display all passengers on a given flight
-void display_passengers(Flight* flight, const vector<Booking*>& bookings) {
-    cout << "Passengers on flight " << flight->get_flight_number() << ":" << endl;
-    for (const auto& booking : bookings) {
-        if (booking->get_flight() == flight) {
-            Passenger* passenger = booking->get_passenger();
-            if (passenger) {
-                passenger->get_passenger_info();
+    // Oldest epoch a reader is pinned at, or UINT64_MAX if none is reading
+    uint64_t oldest_pinned_epoch() {
+        lock_guard<mutex> lock(slots_mutex);
+        uint64_t oldest = UINT64_MAX;
+        for (const auto& reader : slots) {
+            uint64_t epoch = reader.epoch.load(memory_order_seq_cst);
+            if (epoch) {
+                oldest = min(oldest, epoch);
             }
         }
+        return oldest;
     }
-}
 
-// Function to display all passengers on domestic and international flights separately
-void display_passengers_by_flight_type(const vector<Flight*>& flights, const vector<Booking*>& bookings) {
-    cout << "Passengers on Domestic Flights:" << endl;
-    for (const auto& flight : flights) {
-        if (dynamic_cast<DomesticFlight*>(flight)) {
-            display_passengers(flight, bookings);
+public:
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    ~EpochManager() {
+        synchronize();
+    }
+
+    // The process-wide manager shared by every published structure
+    static EpochManager& instance() {
+        static EpochManager manager;
+        return manager;
+    }
+
+    void enter() {
+        if (depth++ == 0) {
+            // seq_cst orders the pin before the reader's loads of published pointers
+            thread_slot().epoch.store(global_epoch.load(memory_order_seq_cst), memory_order_seq_cst);
         }
     }
 
-    cout << "Passengers on International Flights:" << endl;
-    for (const auto& flight : flights) {
-        if (dynamic_cast<InternationalFlight*>(flight)) {
-            display_passengers(flight, bookings);
+    // Readers must not call synchronize() inside a guard, which would wait for themselves
+    void leave() {
+        if (--depth == 0) {
+            slot->epoch.store(0, memory_order_release);
         }
     }
-}
 
-// Function to modify passenger information
-void modify_passenger_info(Passenger* passenger) {
-    int choice;
-    cout << "Modify Passenger Information for " << passenger->get_name() << endl;
-    cout << "1. Email" << endl;
-    cout << "2. Phone Number" << endl;
-    cout << "Enter your choice: ";
-    cin >> choice;
+    // Free an object once no reader can still see it; call after unpublishing it
+    void retire(function<void()> reclaim) {
+        uint64_t epoch = global_epoch.fetch_add(1, memory_order_seq_cst);
+        {
+            lock_guard<mutex> lock(retired_mutex);
+            retired.push_back(Retired{ epoch, move(reclaim) });
+        }
+        collect();
+    }
+
+    // Free every retired object no reader is pinned before
+    void collect() {
+        uint64_t oldest = oldest_pinned_epoch();
+        vector<Retired> ready;
+        {
+            lock_guard<mutex> lock(retired_mutex);
+            auto keep = partition(retired.begin(), retired.end(), [oldest](const Retired& r) { return r.epoch >= oldest; });
+            move(keep, retired.end(), back_inserter(ready));
+            retired.erase(keep, retired.end());
+        }
+        for (auto& r : ready) {
+            r.reclaim();
+        }
+    }
+
+    // Wait until no reader can see anything retired so far, then free all of it
+    void synchronize() {
+        uint64_t epoch = global_epoch.fetch_add(1, memory_order_seq_cst);
+        while (oldest_pinned_epoch() <= epoch) {
+            this_thread::yield();
+        }
+        collect();
+    }
+
+    // Objects retired and not yet freed
+    size_t get_retired_count() {
+        lock_guard<mutex> lock(retired_mutex);
+        return retired.size();
+    }
+};
+
+// EpochGuard class pinning the calling thread's epoch for its lifetime, so nothing it reads from a published
+// structure is freed under it. Guards nest.
+class EpochGuard {
+public:
+    EpochGuard() {
+        EpochManager::instance().enter();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() {
+        EpochManager::instance().leave();
+    }
+};
+
+// Thread pool running parallel loops with work stealing. A loop's index range is cut into chunks dealt
+// round-robin onto per-worker deques; a worker takes chunks from the back of its own deque and, once
+// that is empty, steals from the front of the others', so uneven chunks still keep every thread busy.
+// The calling thread works as the last worker.
+class WorkStealingPool {
+private:
+    typedef function<void(size_t, size_t)> Job; // (index, worker)
+
+    struct Chunk {
+        const Job* job; // Carried with each chunk so a worker never runs a chunk with another loop's job
+        size_t begin;
+        size_t end;
+    };
+
+    struct WorkerQueue {
+        mutex queue_mutex;
+        deque<Chunk> chunks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<WorkerQueue>> queues; // One per worker plus one for the caller
+    mutex pool_mutex;
+    condition_variable work_ready;
+    condition_variable work_done;
+    uint64_t generation = 0;
+    bool stopping = false;
+    atomic<size_t> remaining;
+    mutex loop_mutex; // One loop at a time
+
+    bool take_chunk(size_t worker, Chunk& chunk) {
+        {
+            WorkerQueue& own = *queues[worker];
+            lock_guard<mutex> lock(own.queue_mutex);
+            if (!own.chunks.empty()) {
+                chunk = own.chunks.back();
+                own.chunks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            WorkerQueue& victim = *queues[(worker + i) % queues.size()];
+            lock_guard<mutex> lock(victim.queue_mutex);
+            if (!victim.chunks.empty()) {
+                chunk = victim.chunks.front();
+                victim.chunks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Run chunks until none are left anywhere
+    void work(size_t worker) {
+        Chunk chunk;
+        while (take_chunk(worker, chunk)) {
+            for (size_t i = chunk.begin; i < chunk.end; ++i) {
+                (*chunk.job)(i, worker);
+            }
+            if (remaining.fetch_sub(chunk.end - chunk.begin, memory_order_acq_rel) == chunk.end - chunk.begin) {
+                lock_guard<mutex> lock(pool_mutex);
+                work_done.notify_all();
+            }
+        }
+    }
+
+    void run(size_t worker) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                unique_lock<mutex> lock(pool_mutex);
+                work_ready.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            work(worker);
+        }
+    }
+
+public:
+    // Pool of thread_count threads counting the caller
+    explicit WorkStealingPool(size_t thread_count) : remaining(0) {
+        size_t worker_count = max<size_t>(1, thread_count) - 1;
+        for (size_t i = 0; i <= worker_count; ++i) {
+            queues.emplace_back(new WorkerQueue());
+        }
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers.emplace_back(&WorkStealingPool::run, this, i);
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // The process-wide pool, with one thread per core counting the caller
+    static WorkStealingPool& instance() {
+        static WorkStealingPool pool(max(1u, thread::hardware_concurrency()));
+        return pool;
+    }
+
+    // Number of distinct worker ids parallel_for may pass, counting the caller
+    size_t get_worker_count() const {
+        return queues.size();
+    }
+
+    // Call job(index, worker) for every index below count and return when all calls are done.
+    // Calls for different indexes may run at the same time; calls with the same worker id never do.
+    void parallel_for(size_t count, const Job& job) {
+        lock_guard<mutex> loop_lock(loop_mutex);
+        size_t caller = queues.size() - 1;
+        if (count == 0) {
+            return;
+        }
+        if (workers.empty() || count == 1) {
+            for (size_t i = 0; i < count; ++i) {
+                job(i, caller);
+            }
+            return;
+        }
+        // Several chunks per thread leave room to rebalance by stealing
+        size_t chunk_size = max<size_t>(1, count / (queues.size() * 8));
+        remaining.store(count, memory_order_relaxed);
+        size_t queue = 0;
+        for (size_t begin = 0; begin < count; begin += chunk_size, queue = (queue + 1) % queues.size()) {
+            WorkerQueue& target = *queues[queue];
+            lock_guard<mutex> lock(target.queue_mutex);
+            target.chunks.push_back(Chunk{ &job, begin, min(count, begin + chunk_size) });
+        }
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            ++generation;
+        }
+        work_ready.notify_all();
+        work(caller);
+        unique_lock<mutex> lock(pool_mutex);
+        work_done.wait(lock, [this] { return remaining.load(memory_order_acquire) == 0; });
+    }
+};
+
+// Render count report sections in parallel into per-worker buffers, then join them in index order.
+// render(index, out) appends section index to out and may run on any of the pool's workers.
+template <typename Render>
+string render_report(size_t count, Render render, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    struct Section {
+        size_t index;
+        size_t worker;
+        size_t offset;
+        size_t length;
+    };
+    vector<string> buffers(pool.get_worker_count());
+    vector<vector<Section>> sections(pool.get_worker_count());
+    pool.parallel_for(count, [&](size_t index, size_t worker) {
+        string& buffer = buffers[worker];
+        size_t offset = buffer.size();
+        render(index, buffer);
+        sections[worker].push_back(Section{ index, worker, offset, buffer.size() - offset });
+    });
+
+    // Every index was rendered exactly once, so placing sections by index restores report order
+    vector<Section> ordered(count);
+    size_t total = 0;
+    for (const auto& worker_sections : sections) {
+        for (const auto& section : worker_sections) {
+            ordered[section.index] = section;
+            total += section.length;
+        }
+    }
+    string report;
+    report.reserve(total);
+    for (const auto& section : ordered) {
+        report.append(buffers[section.worker], section.offset, section.length);
+    }
+    return report;
+}
+
+// Render a report with render_report and print it with one write
+template <typename Render>
+void write_report(size_t count, Render render) {
+    string report = render_report(count, render);
+    cout.write(report.data(), static_cast<streamsize>(report.size()));
+    cout.flush();
+}
+
+// NotificationDispatcher class moving observer delivery off the publishing thread.
+// Publishers push into a bounded queue; one background thread delivers in batches and
+// flushes the sink once per batch. Until start() is called, delivery is synchronous.
+class NotificationDispatcher {
+private:
+    struct Notification {
+        ISubject* subject = nullptr;
+        FlightEvent event;
+        chrono::steady_clock::time_point published_at;
+    };
+
+    static constexpr size_t queue_capacity = 4096;
+    static constexpr size_t batch_size = 64;
+
+    BoundedMpscQueue<Notification> queue;
+    INotificationSink* sink;
+    thread worker;
+    atomic<bool> running;
+
+    // Wakes the dispatcher thread when it is idle
+    mutex wake_mutex;
+    condition_variable wake;
+    atomic<bool> sleeping;
+
+    // Metrics
+    atomic<uint64_t> published_count;
+    atomic<uint64_t> delivered_count;
+    atomic<uint64_t> max_queue_depth;
+    atomic<uint64_t> total_latency_ns;
+    atomic<uint64_t> max_latency_ns;
+
+    NotificationDispatcher()
+        : queue(queue_capacity), sink(nullptr), running(false), sleeping(false), published_count(0),
+          delivered_count(0), max_queue_depth(0), total_latency_ns(0), max_latency_ns(0) {}
+
+    static void raise_max(atomic<uint64_t>& maximum, uint64_t value) {
+        uint64_t current = maximum.load(memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, memory_order_relaxed)) {
+        }
+    }
+
+    void deliver_batch(vector<Notification>& batch) {
+        for (auto& notification : batch) {
+            notification.subject->deliver(notification.event);
+            uint64_t latency = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - notification.published_at).count());
+            total_latency_ns.fetch_add(latency, memory_order_relaxed);
+            raise_max(max_latency_ns, latency);
+        }
+        if (sink) {
+            sink->flush();
+        }
+        delivered_count.fetch_add(batch.size(), memory_order_release);
+        batch.clear();
+    }
+
+    void run() {
+        vector<Notification> batch;
+        batch.reserve(batch_size);
+        Notification notification;
+        for (;;) {
+            while (batch.size() < batch_size && queue.try_pop(notification)) {
+                batch.push_back(move(notification));
+            }
+            if (!batch.empty()) {
+                deliver_batch(batch);
+                continue;
+            }
+            if (!running.load(memory_order_acquire)) {
+                return;
+            }
+            // The timeout bounds the delay if a wake-up races with going to sleep
+            unique_lock<mutex> lock(wake_mutex);
+            sleeping.store(true, memory_order_release);
+            wake.wait_for(lock, chrono::milliseconds(1));
+            sleeping.store(false, memory_order_release);
+        }
+    }
+
+public:
+    NotificationDispatcher(const NotificationDispatcher&) = delete;
+    NotificationDispatcher& operator=(const NotificationDispatcher&) = delete;
+
+    ~NotificationDispatcher() {
+        stop();
+    }
+
+    // The process-wide dispatcher used by every flight
+    static NotificationDispatcher& instance() {
+        static NotificationDispatcher dispatcher;
+        return dispatcher;
+    }
+
+    // Start the background dispatcher thread
+    void start() {
+        if (!running.exchange(true)) {
+            worker = thread(&NotificationDispatcher::run, this);
+        }
+    }
+
+    // Deliver everything still queued and stop the dispatcher thread; publishers must be idle
+    void stop() {
+        if (running.exchange(false)) {
+            wake.notify_one();
+            worker.join();
+        }
+    }
+
+    // Queue an event for a subject's observers, or deliver it now if the dispatcher is not running
+    void publish(ISubject* subject, const FlightEvent& event) {
+        if (!running.load(memory_order_acquire)) {
+            subject->deliver(event);
+            if (sink) {
+                sink->flush();
+            }
+            return;
+        }
+        published_count.fetch_add(1, memory_order_relaxed);
+        Notification notification;
+        notification.subject = subject;
+        notification.event = event;
+        notification.published_at = chrono::steady_clock::now();
+        // A full queue pushes back on publishers instead of dropping notifications
+        while (!queue.try_push(move(notification))) {
+            this_thread::yield();
+        }
+        raise_max(max_queue_depth, min(queue.size(), queue_capacity));
+        if (sleeping.load(memory_order_acquire)) {
+            wake.notify_one();
+        }
+    }
+
+    // Wait until every queued message has been delivered
+    void drain() {
+        while (running.load(memory_order_acquire) &&
+               delivered_count.load(memory_order_acquire) < published_count.load(memory_order_relaxed)) {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+
+    // Set the sink observers write to; nullptr discards notifications. Set it before start().
+    void set_sink(INotificationSink* new_sink) {
+        sink = new_sink;
+    }
+
+    INotificationSink* get_sink() {
+        return sink;
+    }
+
+    // Display queue depth and delivery latency
+    void get_dispatcher_stats() const {
+        uint64_t delivered = delivered_count.load();
+        cout << "Notifications published: " << published_count.load() << ", Delivered: " << delivered
+            << ", Queue depth: " << queue.size() << ", Max queue depth: " << max_queue_depth.load()
+            << ", Avg latency (us): " << (delivered ? total_latency_ns.load() / delivered / 1000 : 0)
+            << ", Max latency (us): " << max_latency_ns.load() / 1000 << endl;
+    }
+};
+
+// Booking journal record types. Values are stored in the journal file, so they must not change.
+enum class JournalRecordType : uint8_t {
+    PassengerAdded = 1,          // name, email, phone number, passport number
+    BookingCreated = 2,          // booking ID, passport number, flight number, departure date, seat number; status
+    BookingStatusChanged = 3,    // booking ID; status
+    BookingCancelled = 4,        // booking ID
+    BookingRemoved = 5,          // booking ID
+    ItineraryBookingAdded = 6,   // itinerary ID, booking ID
+    ItineraryBookingRemoved = 7, // itinerary ID, booking ID
+    DaysEvicted = 8,             // first day kept
+    FlightRetimed = 9,           // flight number, departure date, new departure time, new arrival time
+    FlightCancelled = 10,        // flight number, departure date
+    FlightAdded = 11             // flight type, flight number, origin, destination, departure time, arrival time
+};
+
+// A decoded journal record; the fields view the journal bytes
+struct JournalRecord {
+    static constexpr size_t max_fields = 6;
+
+    JournalRecordType type;
+    BookingStatus status;
+    string_view fields[max_fields];
+    size_t field_count = 0;
+};
+
+// Append-only write-ahead journal of booking state changes.
+// Record layout: uint32 payload size | uint32 FNV-1a checksum of the payload | payload, where the payload is
+// uint8 type | uint8 status | uint8 field count | per field: uint32 size, bytes.
+// Appends only copy the record into a buffer. A background thread writes whatever has accumulated and makes
+// it durable with one fdatasync, so callers waiting on durability at the same time share a single sync.
+class BookingJournal {
+private:
+    int fd;
+    bool group_commit;
+    thread flusher;
+    bool running;
+    bool failed;
+
+    mutex journal_mutex;
+    condition_variable work_ready;
+    condition_variable durable;
+    string pending;             // Encoded records not yet written
+    uint64_t appended_sequence; // Sequence number of the newest appended record
+    uint64_t durable_sequence;  // Every record up to this one is on disk
+    off_t durable_size;         // Journal size up to the last durable record
+
+    // Metrics
+    uint64_t sync_count;
+    uint64_t bytes_written;
+
+    // Newest sequence number committed on this thread inside a DeferredCommits scope, or nullptr outside one
+    static inline thread_local uint64_t* deferred_sequence = nullptr;
+
+    BookingJournal()
+        : fd(-1), group_commit(true), running(false), failed(false), appended_sequence(0), durable_sequence(0),
+          durable_size(0), sync_count(0), bytes_written(0) {}
+
+    static uint32_t checksum(const char* data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    static void encode(string& out, JournalRecordType type, BookingStatus status, initializer_list<string_view> fields) {
+        size_t start = out.size();
+        out.resize(start + 8);
+        out += static_cast<char>(type);
+        out += static_cast<char>(status);
+        out += static_cast<char>(fields.size());
+        for (string_view field : fields) {
+            uint32_t size = static_cast<uint32_t>(field.size());
+            out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.append(field.data(), field.size());
+        }
+        uint32_t payload_size = static_cast<uint32_t>(out.size() - start - 8);
+        uint32_t payload_checksum = checksum(&out[start + 8], payload_size);
+        memcpy(&out[start], &payload_size, sizeof(payload_size));
+        memcpy(&out[start + 4], &payload_checksum, sizeof(payload_checksum));
+    }
+
+    // Write a buffer and make it durable; false on any I/O error
+    bool write_and_sync(const string& buffer) {
+        size_t offset = 0;
+        while (offset < buffer.size()) {
+            ssize_t written = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            offset += static_cast<size_t>(written);
+        }
+        int synced;
+        do {
+            synced = fdatasync(fd);
+        } while (synced != 0 && errno == EINTR);
+        return synced == 0;
+    }
+
+    // Record the outcome of writing a batch ending at batch_sequence; called with journal_mutex held.
+    // A failed batch is never durable, and the journal refuses records after it so none can become durable
+    // past it.
+    void finish_batch(bool written, size_t batch_size, uint64_t batch_sequence) {
+        ++sync_count;
+        bytes_written += batch_size;
+        if (written) {
+            durable_sequence = batch_sequence;
+            durable_size += static_cast<off_t>(batch_size);
+        } else {
+            failed = true;
+            // Cut off what was written of the batch so a replay stops at the last durable record; if even
+            // that fails, the file may end in records nobody was told are durable, as after a crash mid-sync
+            bool cut = ftruncate(fd, durable_size) == 0;
+            (void)cut;
+        }
+    }
+
+    void run() {
+        string batch;
+        unique_lock<mutex> lock(journal_mutex);
+        for (;;) {
+            work_ready.wait(lock, [this] { return !pending.empty() || !running; });
+            if (pending.empty()) {
+                return;
+            }
+            if (failed) {
+                // Records appended before the failure was seen are dropped with the rest of the batch
+                pending.clear();
+                continue;
+            }
+            batch.swap(pending);
+            uint64_t batch_sequence = appended_sequence;
+            // Appenders keep filling the next batch while this one is written
+            lock.unlock();
+            bool written = write_and_sync(batch);
+            lock.lock();
+            finish_batch(written, batch.size(), batch_sequence);
+            batch.clear();
+            durable.notify_all();
+        }
+    }
+
+public:
+    BookingJournal(const BookingJournal&) = delete;
+    BookingJournal& operator=(const BookingJournal&) = delete;
+
+    ~BookingJournal() {
+        close();
+    }
+
+    // The process-wide journal; it records nothing until opened
+    static BookingJournal& instance() {
+        static BookingJournal journal;
+        return journal;
+    }
+
+    // Decode the record at the front of data and advance past it.
+    // Returns false at the end of the data or at a torn or corrupt record.
+    static bool read_record(string_view& data, JournalRecord& record) {
+        uint32_t payload_size, payload_checksum;
+        if (data.size() < 8) {
+            return false;
+        }
+        memcpy(&payload_size, data.data(), sizeof(payload_size));
+        memcpy(&payload_checksum, data.data() + 4, sizeof(payload_checksum));
+        if (payload_size < 3 || payload_size > data.size() - 8 || checksum(data.data() + 8, payload_size) != payload_checksum) {
+            return false;
+        }
+        string_view payload = data.substr(8, payload_size);
+        record.type = static_cast<JournalRecordType>(payload[0]);
+        record.status = static_cast<BookingStatus>(payload[1]);
+        record.field_count = static_cast<unsigned char>(payload[2]);
+        if (record.field_count > JournalRecord::max_fields) {
+            return false;
+        }
+        payload.remove_prefix(3);
+        for (size_t i = 0; i < record.field_count; ++i) {
+            uint32_t size;
+            if (payload.size() < sizeof(size)) {
+                return false;
+            }
+            memcpy(&size, payload.data(), sizeof(size));
+            if (size > payload.size() - sizeof(size)) {
+                return false;
+            }
+            record.fields[i] = payload.substr(sizeof(size), size);
+            payload.remove_prefix(sizeof(size) + size);
+        }
+        data.remove_prefix(8 + payload_size);
+        return true;
+    }
+
+    // Open the journal for appending, first cutting it to valid_size bytes to drop a torn tail left by a crash.
+    // With group_commit off every record is written and synced on its own, for comparison.
+    bool open(const string& path, size_t valid_size, bool use_group_commit = true) {
+        close();
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, static_cast<off_t>(valid_size)) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        group_commit = use_group_commit;
+        failed = false;
+        appended_sequence = durable_sequence = 0;
+        durable_size = static_cast<off_t>(valid_size);
+        sync_count = bytes_written = 0;
+        if (group_commit) {
+            running = true;
+            flusher = thread(&BookingJournal::run, this);
+        }
+        return true;
+    }
+
+    // Make everything appended durable and close the journal; appenders must be idle
+    void close() {
+        if (fd < 0) {
+            return;
+        }
+        if (flusher.joinable()) {
+            {
+                lock_guard<mutex> lock(journal_mutex);
+                running = false;
+            }
+            work_ready.notify_one();
+            flusher.join();
+        }
+        ::close(fd);
+        fd = -1;
+    }
+
+    bool is_open() const {
+        return fd >= 0;
+    }
+
+    // Append a record and return its sequence number, or 0 if the journal is closed.
+    // The record is durable once wait_durable for its sequence number returns. After a write has failed
+    // records are refused: they get a sequence number that wait_durable reports as failed.
+    uint64_t append(JournalRecordType type, BookingStatus status, initializer_list<string_view> fields) {
+        if (fd < 0) {
+            return 0;
+        }
+        lock_guard<mutex> lock(journal_mutex);
+        uint64_t sequence = ++appended_sequence;
+        if (failed) {
+            return sequence;
+        }
+        encode(pending, type, status, fields);
+        if (!group_commit) {
+            finish_batch(write_and_sync(pending), pending.size(), sequence);
+            pending.clear();
+        } else {
+            work_ready.notify_one();
+        }
+        return sequence;
+    }
+
+    // Wait until the record with the given sequence number, and all before it, are on disk.
+    // Throws JournalException if the journal could not be written.
+    void wait_durable(uint64_t sequence) {
+        unique_lock<mutex> lock(journal_mutex);
+        durable.wait(lock, [this, sequence] { return durable_sequence >= sequence || failed; });
+        if (durable_sequence < sequence) {
+            throw JournalException();
+        }
+    }
+
+    // Append a record and wait until it is durable, or inside a DeferredCommits scope until the scope waits
+    void commit(JournalRecordType type, BookingStatus status, initializer_list<string_view> fields) {
+        uint64_t sequence = append(type, status, fields);
+        if (deferred_sequence) {
+            *deferred_sequence = max(*deferred_sequence, sequence);
+        } else if (sequence) {
+            wait_durable(sequence);
+        }
+    }
+
+    // Wait until everything appended so far is durable, or inside a DeferredCommits scope until the scope waits
+    void sync() {
+        uint64_t sequence;
+        {
+            lock_guard<mutex> lock(journal_mutex);
+            sequence = appended_sequence;
+        }
+        if (deferred_sequence) {
+            *deferred_sequence = max(*deferred_sequence, sequence);
+        } else {
+            wait_durable(sequence);
+        }
+    }
+
+    // Scope that lets a thread apply journaled changes under its own locks and wait for them to be durable
+    // after releasing those locks, so concurrent threads share syncs. Changes are visible to other threads
+    // before they are durable; none may be reported done to a client until wait() returns.
+    class DeferredCommits {
+    private:
+        uint64_t sequence = 0;
+
+    public:
+        DeferredCommits() {
+            deferred_sequence = &sequence;
+        }
+
+        DeferredCommits(const DeferredCommits&) = delete;
+        DeferredCommits& operator=(const DeferredCommits&) = delete;
+
+        ~DeferredCommits() {
+            deferred_sequence = nullptr;
+        }
+
+        // Wait until everything committed in the scope is durable; throws JournalException if it cannot be
+        void wait() {
+            deferred_sequence = nullptr;
+            if (sequence) {
+                BookingJournal::instance().wait_durable(sequence);
+            }
+        }
+    };
+
+    // Empty the journal once its records are covered by a snapshot; appenders must be idle
+    bool truncate() {
+        if (fd < 0) {
+            return true;
+        }
+        sync();
+        lock_guard<mutex> lock(journal_mutex);
+        if (ftruncate(fd, 0) != 0 || fsync(fd) != 0) {
+            return false;
+        }
+        durable_size = 0;
+        return true;
+    }
+
+    // Records appended and syncs made since the journal was opened
+    uint64_t get_record_count() {
+        lock_guard<mutex> lock(journal_mutex);
+        return appended_sequence;
+    }
+
+    uint64_t get_sync_count() {
+        lock_guard<mutex> lock(journal_mutex);
+        return sync_count;
+    }
+
+    // Display records, syncs and the average batch per sync
+    void get_journal_stats() {
+        lock_guard<mutex> lock(journal_mutex);
+        cout << "Journal records: " << appended_sequence << ", Syncs: " << sync_count
+            << ", Records per sync: " << (sync_count ? static_cast<double>(appended_sequence) / sync_count : 0.0)
+            << ", Bytes written: " << bytes_written << endl;
+    }
+};
+
+// Base class for Person
+class Person {
+protected:
+    string name;
+    string email;
+    string phone_number;
+
+public:
+    // Constructor to initialize a person's details
+    Person(const string& name, const string& email, const string& phone_number)
+        : name(name), email(email), phone_number(phone_number) {}
+
+    // Method to display person's details
+    virtual void get_details() const {
+        string out;
+        append_details(out);
+        cout << out;
+    }
+
+    // Append the person's details to a report
+    void append_details(string& out) const {
+        out += "Name: ";
+        out += name;
+        out += ", Email: ";
+        out += email;
+        out += ", Phone Number: ";
+        out += phone_number;
+        out += '\n';
+    }
+
+    const string& get_name() const {
+        return name;
+    }
+
+    const string& get_email() const {
+        return email;
+    }
+
+    const string& get_phone_number() const {
+        return phone_number;
+    }
+
+    void set_email(const string& new_email) {
+        email = new_email;
+    }
+
+    void set_phone_number(const string& new_phone_number) {
+        phone_number = new_phone_number;
+    }
+};
+
+// Passenger class inheriting Person and implementing IObserver
+class Passenger : public Person, public IObserver {
+private:
+    string passport_number;
+
+public:
+    // Constructor to initialize a passenger's details
+    Passenger(const string& name, const string& email, const string& phone_number, const string& passport_number)
+        : Person(name, email, phone_number), passport_number(passport_number) {}
+
+    // Method to display passenger's details
+    void get_passenger_info() const {
+        string out;
+        append_passenger_info(out);
+        cout << out;
+    }
+
+    // Append the passenger's details to a report
+    void append_passenger_info(string& out) const {
+        append_details(out);
+        out += "Passport Number: ";
+        out += passport_number;
+        out += '\n';
+    }
+
+    // Method to receive updates
+    void update(const FlightEvent& event) override {
+        INotificationSink* sink = NotificationDispatcher::instance().get_sink();
+        if (sink) {
+            sink->write(event);
+        }
+    }
+
+    const string& get_passport_number() const {
+        return passport_number;
+    }
+};
+
+// PassengerRegistry class owning all passengers with an index by passport number
+class PassengerRegistry {
+private:
+    // std::deque allocates in fixed-size blocks, so passengers never move once added
+    deque<Passenger> passengers;
+    // Keys view the passport_number stored inside each Passenger, so lookups never copy strings
+    unordered_map<string_view, uint32_t> by_passport;
+
+public:
+    PassengerRegistry() = default;
+    PassengerRegistry(const PassengerRegistry&) = delete;
+    PassengerRegistry& operator=(const PassengerRegistry&) = delete;
+
+    // Add a passenger, returning an invalid handle if the passport number is already registered
+    PassengerHandle add_passenger(const string& name, const string& email, const string& phone_number, const string& passport_number) {
+        if (by_passport.count(passport_number)) {
+            return PassengerHandle();
+        }
+        uint32_t index = static_cast<uint32_t>(passengers.size());
+        passengers.emplace_back(name, email, phone_number, passport_number);
+        by_passport.emplace(passengers.back().get_passport_number(), index);
+        // Made durable by the next commit, which a booking for this passenger will be
+        BookingJournal::instance().append(JournalRecordType::PassengerAdded, BookingStatus::Pending,
+                                          { name, email, phone_number, passport_number });
+        return PassengerHandle{ index };
+    }
+
+    // Find a passenger by passport number, returning an invalid handle if not registered
+    PassengerHandle find(string_view passport_number) const {
+        auto it = by_passport.find(passport_number);
+        return it == by_passport.end() ? PassengerHandle() : PassengerHandle{ it->second };
+    }
+
+    Passenger& get(PassengerHandle handle) {
+        return passengers[handle.index];
+    }
+
+    const Passenger& get(PassengerHandle handle) const {
+        return passengers[handle.index];
+    }
+
+    size_t size() const {
+        return passengers.size();
+    }
+
+    // Drop every passenger; no booking may still refer to one
+    void clear() {
+        by_passport.clear();
+        passengers.clear();
+    }
+};
+
+// Append the text form of an event to out
+void format_event(const FlightEvent& event, string& out) {
+    switch (event.kind) {
+    case EventKind::Announcement:
+        out += event.text;
+        return;
+    case EventKind::BookingConfirmed:
+        out += "Booking confirmed for flight ";
+        break;
+    case EventKind::BookingCancelled:
+        out += "Booking cancelled for flight ";
+        break;
+    case EventKind::BookingStatusChanged:
+        out += "Booking status changed for flight ";
+        break;
+    }
+    out += event.origin;
+    out += " to ";
+    out += event.destination;
+    out += " for passenger ";
+    out += event.passenger_name;
+    if (event.kind == EventKind::BookingStatusChanged) {
+        out += " to ";
+        out += booking_status_name(event.status);
+    }
+}
+
+// ConsoleSink class formatting events into a reusable buffer and writing it to cout once per flush
+class ConsoleSink : public INotificationSink {
+private:
+    string buffer; // Cleared after each flush but keeps its capacity, so formatting does not allocate
+
+public:
+    void write(const FlightEvent& event) override {
+        buffer += "Passenger received update: ";
+        format_event(event, buffer);
+        buffer += '\n';
+    }
+
+    void flush() override {
+        if (!buffer.empty()) {
+            cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            cout.flush();
+            buffer.clear();
+        }
+    }
+};
+
+// Kinds of flight the system operates
+enum class FlightType : uint8_t {
+    Domestic,
+    International
+};
+
+// Layout of one cabin: consecutive rows sharing the same seat letters
+struct Cabin {
+    string name;
+    int first_row;
+    int row_count;
+    string seat_letters;
+};
+
+// Compile-time properties of each flight kind
+template <FlightType Kind>
+struct FlightKind;
+
+template <>
+struct FlightKind<FlightType::Domestic> {
+    static constexpr const char* name = "Domestic";
+    static constexpr double base_fare = 50.0;
+
+    // A seat can be sold while any is free
+    static constexpr bool seats_available(size_t occupied_seats, size_t total_seats) {
+        return occupied_seats < total_seats;
+    }
+
+    // Single-class cabin shared by all domestic flights
+    static const vector<Cabin>& cabin_layout() {
+        static const vector<Cabin> layout = {
+            { "Economy", 1, 30, "ABCDEF" }
+        };
+        return layout;
+    }
+};
+
+template <>
+struct FlightKind<FlightType::International> {
+    static constexpr const char* name = "International";
+    static constexpr double base_fare = 200.0;
+
+    // A seat can be sold while any is free
+    static constexpr bool seats_available(size_t occupied_seats, size_t total_seats) {
+        return occupied_seats < total_seats;
+    }
+
+    // Two-class cabin shared by all international flights
+    static const vector<Cabin>& cabin_layout() {
+        static const vector<Cabin> layout = {
+            { "Business", 1, 8, "ACDF" },
+            { "Economy", 10, 36, "ABCDEFGHK" }
+        };
+        return layout;
+    }
+};
+
+// Parse a flight kind name such as "Domestic", returning false if it names no kind
+bool parse_flight_type(string_view text, FlightType& flight_type) {
+    if (text == FlightKind<FlightType::Domestic>::name) {
+        flight_type = FlightType::Domestic;
+    } else if (text == FlightKind<FlightType::International>::name) {
+        flight_type = FlightType::International;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Name of a flight kind, as parse_flight_type reads it
+const char* flight_type_name(FlightType flight_type) {
+    return flight_type == FlightType::Domestic ? FlightKind<FlightType::Domestic>::name : FlightKind<FlightType::International>::name;
+}
+
+// SeatMap class tracking occupied seats of a flight as one bitset per cabin.
+// Seat bits are atomic words, so threads can reserve seats on the same flight without a lock.
+class SeatMap {
+private:
+    const vector<Cabin>* cabins;
+    // Each cabin starts on a fresh 64-bit word so its bitset can be scanned on its own
+    vector<uint32_t> first_word;
+    vector<uint32_t> seat_counts;
+    unique_ptr<atomic<uint64_t>[]> occupied;
+    size_t total_seats = 0;
+    atomic<size_t> occupied_seats;
+
+    // Seat index layout: word offset of the cabin * 64 + position within the cabin
+    int to_index(size_t cabin, int position) const {
+        return static_cast<int>(first_word[cabin] * 64 + position);
+    }
+
+    size_t cabin_of(int seat) const {
+        size_t cabin = 0;
+        while (cabin + 1 < first_word.size() && static_cast<uint32_t>(seat) >= first_word[cabin + 1] * 64) {
+            ++cabin;
+        }
+        return cabin;
+    }
+
+public:
+    explicit SeatMap(const vector<Cabin>& layout) : cabins(&layout), occupied_seats(0) {
+        uint32_t words = 0;
+        for (const auto& cabin : layout) {
+            uint32_t seats = static_cast<uint32_t>(cabin.row_count * cabin.seat_letters.size());
+            first_word.push_back(words);
+            seat_counts.push_back(seats);
+            words += (seats + 63) / 64;
+            total_seats += seats;
+        }
+        occupied.reset(new atomic<uint64_t>[words]);
+        for (uint32_t w = 0; w < words; ++w) {
+            occupied[w].store(0, memory_order_relaxed);
+        }
+    }
+
+    const vector<Cabin>& get_cabins() const {
+        return *cabins;
+    }
+
+    // Convert a label such as "12A" to a seat index, or -1 if the flight has no such seat
+    int find_seat(const string& label) const {
+        size_t digits = 0;
+        while (digits < label.size() && isdigit(static_cast<unsigned char>(label[digits]))) {
+            ++digits;
+        }
+        if (digits == 0 || digits + 1 != label.size() || digits > 4) {
+            return -1;
+        }
+        int row = stoi(label.substr(0, digits));
+        char letter = static_cast<char>(toupper(static_cast<unsigned char>(label[digits])));
+        for (size_t c = 0; c < cabins->size(); ++c) {
+            const Cabin& cabin = (*cabins)[c];
+            size_t column = cabin.seat_letters.find(letter);
+            if (row >= cabin.first_row && row < cabin.first_row + cabin.row_count && column != string::npos) {
+                int letters = static_cast<int>(cabin.seat_letters.size());
+                return to_index(c, (row - cabin.first_row) * letters + static_cast<int>(column));
+            }
+        }
+        return -1;
+    }
+
+    // Convert a seat index back to its label
+    string seat_label(int seat) const {
+        size_t c = cabin_of(seat);
+        const Cabin& cabin = (*cabins)[c];
+        int position = seat - to_index(c, 0);
+        int letters = static_cast<int>(cabin.seat_letters.size());
+        return to_string(cabin.first_row + position / letters) + cabin.seat_letters[position % letters];
+    }
+
+    bool is_free(int seat) const {
+        return !(occupied[seat / 64].load(memory_order_acquire) & (uint64_t(1) << (seat % 64)));
+    }
+
+    // Mark a seat occupied, returning false if it was already taken.
+    // fetch_or makes the test and the set one atomic step, so two threads can never both win a seat.
+    bool reserve(int seat) {
+        uint64_t bit = uint64_t(1) << (seat % 64);
+        if (occupied[seat / 64].fetch_or(bit, memory_order_acq_rel) & bit) {
+            return false;
+        }
+        occupied_seats.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+    // Mark a seat free again
+    void release(int seat) {
+        uint64_t bit = uint64_t(1) << (seat % 64);
+        if (occupied[seat / 64].fetch_and(~bit, memory_order_acq_rel) & bit) {
+            occupied_seats.fetch_sub(1, memory_order_relaxed);
+        }
+    }
+
+    // Lowest free seat of a cabin, found with a find-first-zero scan over its words, or -1 if full
+    int next_free_seat(size_t cabin) const {
+        uint32_t words = (seat_counts[cabin] + 63) / 64;
+        for (uint32_t w = 0; w < words; ++w) {
+            uint64_t free_bits = ~occupied[first_word[cabin] + w].load(memory_order_acquire);
+            if (free_bits) {
+                int position = static_cast<int>(w * 64) + __builtin_ctzll(free_bits);
+                return position < static_cast<int>(seat_counts[cabin]) ? to_index(cabin, position) : -1;
+            }
+        }
+        return -1;
+    }
+
+    // Lowest free seat in any cabin, or -1 if the flight is full
+    int next_free_seat() const {
+        for (size_t c = 0; c < first_word.size(); ++c) {
+            int seat = next_free_seat(c);
+            if (seat >= 0) {
+                return seat;
+            }
+        }
+        return -1;
+    }
+
+    // Find and reserve the lowest free seat in one step, retrying the compare-and-swap if another
+    // thread takes a seat in the same word first; returns -1 if the flight is full
+    int claim_next_free_seat() {
+        for (size_t c = 0; c < first_word.size(); ++c) {
+            uint32_t words = (seat_counts[c] + 63) / 64;
+            for (uint32_t w = 0; w < words; ++w) {
+                atomic<uint64_t>& word = occupied[first_word[c] + w];
+                uint64_t current = word.load(memory_order_acquire);
+                while (~current) {
+                    int position = static_cast<int>(w * 64) + __builtin_ctzll(~current);
+                    if (position >= static_cast<int>(seat_counts[c])) {
+                        break;
+                    }
+                    uint64_t bit = uint64_t(1) << (position % 64);
+                    if (word.compare_exchange_weak(current, current | bit, memory_order_acq_rel, memory_order_acquire)) {
+                        occupied_seats.fetch_add(1, memory_order_relaxed);
+                        return to_index(c, position);
+                    }
+                }
+            }
+        }
+        return -1;
+    }
+
+    bool has_free_seat() const {
+        return occupied_seats.load(memory_order_relaxed) < total_seats;
+    }
+
+    size_t get_total_seats() const {
+        return total_seats;
+    }
+
+    size_t get_occupied_seats() const {
+        return occupied_seats.load(memory_order_relaxed);
+    }
+};
+
+// Link embedded in each booking so a flight can list its bookings without scanning all of them
+struct ManifestLink {
+    ManifestLink* prev = nullptr;
+    ManifestLink* next = nullptr;
+};
+
+// Flight class implementing ISubject; flights are created as TypedFlight of their kind, which supplies
+// everything that depends on the kind
+class Flight : public ISubject {
+protected:
+    // Interned through SymbolTable, so equality checks are integer compares
+    Symbol flight_number;
+    Symbol origin;
+    Symbol destination;
+    // Minutes since 1970-01-01 00:00, parsed once so time comparisons are integer compares
+    int32_t departure_minutes;
+    int32_t arrival_minutes;
+    vector<IObserver*> observers;
+    // Position in observers and attach count of each observer, for constant-time detach
+    struct ObserverEntry {
+        size_t position;
+        uint32_t attach_count;
+    };
+    unordered_map<IObserver*, ObserverEntry> observer_entries;
+    // Guards the observer containers, which the dispatcher thread reads while the menu thread attaches
+    mutex observers_mutex;
+    SeatMap seats;
+    // Sentinel of the circular list of this flight's bookings, kept in booking order
+    ManifestLink manifest;
+    size_t booking_count = 0;
+    BookingTotals booking_totals;
+    uint32_t removed_cancellations = 0; // Cancelled bookings since removed, which booking_totals still counts
+
+    // Constructor to initialize flight details
+    Flight(const string& flight_number, const string& origin, const string& destination, const string& departure_time,
+           const string& arrival_time, const vector<Cabin>& cabin_layout)
+        : flight_number(SymbolTable::instance().intern(flight_number)),
+          origin(SymbolTable::instance().intern(origin)),
+          destination(SymbolTable::instance().intern(destination)),
+          seats(cabin_layout) {
+        manifest.prev = &manifest;
+        manifest.next = &manifest;
+        if (!parse_timestamp(departure_time, departure_minutes) || !parse_timestamp(arrival_time, arrival_minutes) ||
+            arrival_minutes < departure_minutes) {
+            throw InvalidFlightTimeException();
+        }
+    }
+
+    // Constructor for flights whose times are already minutes since the epoch
+    Flight(string_view flight_number, string_view origin, string_view destination, int32_t departure_minutes,
+           int32_t arrival_minutes, const vector<Cabin>& cabin_layout)
+        : flight_number(SymbolTable::instance().intern(flight_number)),
+          origin(SymbolTable::instance().intern(origin)),
+          destination(SymbolTable::instance().intern(destination)),
+          departure_minutes(departure_minutes), arrival_minutes(arrival_minutes),
+          seats(cabin_layout) {
+        manifest.prev = &manifest;
+        manifest.next = &manifest;
+        if (arrival_minutes < departure_minutes) {
+            throw InvalidFlightTimeException();
+        }
+    }
+
+public:
+    virtual ~Flight() {}
+
+    // Method to display flight details
+    void get_flight_info() const {
+        string out;
+        append_flight_info(out);
+        cout << out;
+    }
+
+    // Append the flight's details to a report
+    void append_flight_info(string& out) const {
+        append_flight_info(out, get_flight_number(), get_origin(), get_destination(), departure_minutes, arrival_minutes);
+    }
+
+    // Append flight details in the report format, from fields taken elsewhere such as a published schedule
+    static void append_flight_info(string& out, string_view flight_number, string_view origin, string_view destination,
+                                   int32_t departure_minutes, int32_t arrival_minutes) {
+        out += "Flight Number: ";
+        out += flight_number;
+        out += ", Origin: ";
+        out += origin;
+        out += ", Destination: ";
+        out += destination;
+        out += ", Departure Time: ";
+        out += format_timestamp(departure_minutes);
+        out += ", Arrival Time: ";
+        out += format_timestamp(arrival_minutes);
+        out += '\n';
+    }
+
+    // Change the flight's times. The calendar holding the flight must re-place it, so only ScheduleCalendar calls this.
+    void retime(int32_t new_departure_minutes, int32_t new_arrival_minutes) {
+        if (new_arrival_minutes < new_departure_minutes) {
+            throw InvalidFlightTimeException();
+        }
+        departure_minutes = new_departure_minutes;
+        arrival_minutes = new_arrival_minutes;
+    }
+
+    // Method to check availability under the kind's policy; fares come from FareEngine
+    virtual bool check_availability() const = 0;
+
+    virtual FlightType get_flight_type() const = 0;
+
+    // Fare of a seat under the default fare rules, which revenue totals count
+    virtual double get_base_fare() const = 0;
+
+    // Return the flight to the pool of its kind; only FlightFactory::destroy_flight calls this
+    virtual void destroy() = 0;
+
+    // Totals of the bookings on this flight; BookingLedger keeps them current
+    const BookingTotals& get_booking_totals() const {
+        return booking_totals;
+    }
+
+    BookingTotals& get_booking_totals() {
+        return booking_totals;
+    }
+
+    // Cancelled bookings no longer in the store; a full scan adds them to the cancellations it finds
+    uint32_t get_removed_cancellations() const {
+        return removed_cancellations;
+    }
+
+    // Record cancelled bookings leaving the store, or restore the count from a snapshot
+    void count_removed_cancellations(uint32_t count) {
+        removed_cancellations += count;
+    }
+
+    // Attach an observer; attaching again only counts, so each observer gets one copy of every event
+    void attach(IObserver* observer) override {
+        lock_guard<mutex> lock(observers_mutex);
+        auto inserted = observer_entries.emplace(observer, ObserverEntry{ observers.size(), 1 });
+        if (inserted.second) {
+            observers.push_back(observer);
+        } else {
+            ++inserted.first->second.attach_count;
+        }
+    }
+
+    // Detach an observer once; it stops receiving events when every attach has been undone
+    void detach(IObserver* observer) override {
+        lock_guard<mutex> lock(observers_mutex);
+        auto it = observer_entries.find(observer);
+        if (it == observer_entries.end() || --it->second.attach_count > 0) {
+            return;
+        }
+        // Swap-and-pop keeps removal constant time
+        size_t position = it->second.position;
+        observers[position] = observers.back();
+        observer_entries[observers[position]].position = position;
+        observers.pop_back();
+        observer_entries.erase(it);
+    }
+
+    // Notify all observers through the dispatcher
+    void notify(const FlightEvent& event) override {
+        INSTRUMENT_SCOPE(Probe::Notify);
+        NotificationDispatcher::instance().publish(this, event);
+    }
+
+    // Deliver an event to all observers
+    void deliver(const FlightEvent& event) override {
+        INSTRUMENT_SCOPE(Probe::Deliver);
+        lock_guard<mutex> lock(observers_mutex);
+        for (auto* observer : observers) {
+            observer->update(event);
+        }
+    }
+
+    // Build an event about this flight for a passenger, by name
+    FlightEvent make_event(EventKind kind, string_view passenger_name, BookingStatus status, const char* text = nullptr) const {
+        return FlightEvent{ kind, status, get_flight_number(), get_origin(), get_destination(), passenger_name, text };
+    }
+
+    // Add a booking to the end of this flight's manifest
+    void link_booking(ManifestLink* link) {
+        link->prev = manifest.prev;
+        link->next = &manifest;
+        manifest.prev->next = link;
+        manifest.prev = link;
+        ++booking_count;
+    }
+
+    // Remove a booking from this flight's manifest in constant time
+    void unlink_booking(ManifestLink* link) {
+        link->prev->next = link->next;
+        link->next->prev = link->prev;
+        link->prev = nullptr;
+        link->next = nullptr;
+        --booking_count;
+    }
+
+    // Bounds of the manifest: iterate from manifest_begin() along next until manifest_end()
+    const ManifestLink* manifest_begin() const { return manifest.next; }
+    const ManifestLink* manifest_end() const { return &manifest; }
+    size_t get_booking_count() const { return booking_count; }
+
+    // Send a free-text announcement to all observers; text must outlive delivery
+    void announce(const char* text) {
+        notify(make_event(EventKind::Announcement, string_view(), BookingStatus::Pending, text));
+    }
+
+    const string& get_origin() const { return SymbolTable::instance().name(origin); }
+    const string& get_destination() const { return SymbolTable::instance().name(destination); }
+    const string& get_flight_number() const { return SymbolTable::instance().name(flight_number); }
+    Symbol get_origin_id() const { return origin; }
+    Symbol get_destination_id() const { return destination; }
+    Symbol get_flight_number_id() const { return flight_number; }
+    SeatMap& get_seat_map() { return seats; }
+    const SeatMap& get_seat_map() const { return seats; }
+    int32_t get_departure_minutes() const { return departure_minutes; }
+    int32_t get_arrival_minutes() const { return arrival_minutes; }
+};
+
+// Flight of one kind. The kind is a template parameter, so code working on one kind at a time
+// gets its properties at compile time instead of through RTTI or virtual calls.
+// The class is final, so calls through a TypedFlight resolve statically to the kind's policies.
+template <FlightType Kind>
+class TypedFlight final : public Flight {
+public:
+    typedef FlightKind<Kind> Traits;
+
+    // Flights of each kind come from their own pool
+    static ObjectPool<TypedFlight>& pool() {
+        static ObjectPool<TypedFlight> flight_pool;
+        return flight_pool;
+    }
+
+    // Constructor to initialize flight details
+    TypedFlight(const string& flight_number, const string& origin, const string& destination, const string& departure_time, const string& arrival_time)
+        : Flight(flight_number, origin, destination, departure_time, arrival_time, Traits::cabin_layout()) {}
+
+    TypedFlight(string_view flight_number, string_view origin, string_view destination, int32_t departure_minutes, int32_t arrival_minutes)
+        : Flight(flight_number, origin, destination, departure_minutes, arrival_minutes, Traits::cabin_layout()) {}
+
+    bool check_availability() const override {
+        return Traits::seats_available(seats.get_occupied_seats(), seats.get_total_seats());
+    }
+
+    FlightType get_flight_type() const override {
+        return Kind;
+    }
+
+    double get_base_fare() const override {
+        return Traits::base_fare;
+    }
+
+    void destroy() override {
+        pool().destroy(this);
+    }
+};
+
+typedef TypedFlight<FlightType::Domestic> DomesticFlight;
+typedef TypedFlight<FlightType::International> InternationalFlight;
+
+// FlightFactory class for creating flight instances
+class FlightFactory {
+public:
+    // Static method to create flight instances based on flight type
+    static Flight* create_flight(FlightType flight_type, const string& flight_number, const string& origin, const string& destination,
+                                 const string& departure_time, const string& arrival_time) {
+        if (flight_type == FlightType::Domestic) {
+            return DomesticFlight::pool().create(flight_number, origin, destination, departure_time, arrival_time);
+        }
+        return InternationalFlight::pool().create(flight_number, origin, destination, departure_time, arrival_time);
+    }
+
+    // Static method to create a flight from already-parsed fields, as loaders do
+    static Flight* create_flight(FlightType flight_type, string_view flight_number, string_view origin, string_view destination, int32_t departure_minutes, int32_t arrival_minutes) {
+        if (flight_type == FlightType::Domestic) {
+            return DomesticFlight::pool().create(flight_number, origin, destination, departure_minutes, arrival_minutes);
+        }
+        return InternationalFlight::pool().create(flight_number, origin, destination, departure_minutes, arrival_minutes);
+    }
+
+    // Static method to destroy a flight created by create_flight
+    static void destroy_flight(Flight* flight) {
+        flight->destroy();
+    }
+};
+
+// Seat hold produced by BookingEngine::reserve and moved on by confirm or cancel
+struct Reservation {
+    enum State : uint8_t { Empty, Held, Confirmed, Cancelled };
+
+    Flight* flight = nullptr;
+    int seat = -1;
+    atomic<uint8_t> state{ Empty };
+};
+
+// BookingEngine class reserving, confirming and cancelling seats from many threads without a global lock.
+// Seat ownership is decided by atomic operations on each flight's seat bitmap, and each reservation
+// changes state by compare-and-swap, so a seat is never sold twice and a hold is released at most once.
+// Every Booking holds its seat through the shared instance().
+class BookingEngine {
+private:
+    atomic<uint64_t> reserved{ 0 };
+    atomic<uint64_t> confirmed{ 0 };
+    atomic<uint64_t> cancelled{ 0 };
+    atomic<uint64_t> rejected{ 0 };
+
+    // Record a seat already claimed on the flight's seat map, or count a rejection if seat is -1
+    bool hold(Flight& flight, int seat, Reservation& reservation) {
+        if (seat < 0) {
+            rejected.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+        reservation.flight = &flight;
+        reservation.seat = seat;
+        reservation.state.store(Reservation::Held, memory_order_release);
+        reserved.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+public:
+    // The engine bookings reserve their seats through
+    static BookingEngine& instance() {
+        static BookingEngine engine;
+        return engine;
+    }
+
+    // Hold a specific seat; fails if the seat does not exist or is taken
+    bool reserve(Flight& flight, const string& seat_label, Reservation& reservation) {
+        int seat = flight.get_seat_map().find_seat(seat_label);
+        if (seat >= 0 && !flight.get_seat_map().reserve(seat)) {
+            seat = -1;
+        }
+        return hold(flight, seat, reservation);
+    }
+
+    // Hold the next free seat on the flight; fails if the flight is full
+    bool reserve_any(Flight& flight, Reservation& reservation) {
+        return hold(flight, flight.get_seat_map().claim_next_free_seat(), reservation);
+    }
+
+    // Turn a hold into a sale; fails if the reservation is not currently held
+    bool confirm(Reservation& reservation) {
+        uint8_t expected = Reservation::Held;
+        if (!reservation.state.compare_exchange_strong(expected, Reservation::Confirmed, memory_order_acq_rel)) {
+            return false;
+        }
+        confirmed.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+    // Release a held or confirmed seat; only the thread that wins the state change frees the seat
+    bool cancel(Reservation& reservation) {
+        uint8_t current = reservation.state.load(memory_order_acquire);
+        while (current == Reservation::Held || current == Reservation::Confirmed) {
+            if (reservation.state.compare_exchange_weak(current, Reservation::Cancelled, memory_order_acq_rel)) {
+                reservation.flight->get_seat_map().release(reservation.seat);
+                cancelled.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Display engine counters
+    void get_engine_stats() const {
+        cout << "Reserved: " << reserved.load() << ", Confirmed: " << confirmed.load()
+            << ", Cancelled: " << cancelled.load() << ", Rejected: " << rejected.load() << endl;
+    }
+};
+
+// BookingLedger class keeping booking totals per flight, rolled up per route and per departure day. Pending and
+// confirmed bookings are counted until they are destroyed, cancellations for as long as their flight is scheduled,
+// and every status change moves a booking between counts, so occupancy, cancellation and revenue queries are
+// lookups instead of scans. Like the bookings, it has one writer at a time.
+class BookingLedger {
+private:
+    unordered_map<uint64_t, BookingTotals> by_route; // Keyed by origin and destination symbols
+    map<int32_t, BookingTotals> by_day;
+
+    BookingLedger() = default;
+
+    static uint64_t route_key(Symbol origin, Symbol destination) {
+        return static_cast<uint64_t>(origin) << 32 | destination;
+    }
+
+    // Drop roll-ups with no bookings left, so evicted days and unused routes cost nothing
+    template <typename Map, typename Key>
+    static void update(Map& totals, const Key& key, BookingStatus status, double fare, int delta) {
+        auto it = totals.emplace(key, BookingTotals()).first;
+        it->second.count(status, fare, delta);
+        if (it->second.empty()) {
+            totals.erase(it);
+        }
+    }
+
+public:
+    BookingLedger(const BookingLedger&) = delete;
+    BookingLedger& operator=(const BookingLedger&) = delete;
+
+    // The process-wide ledger shared by every booking
+    static BookingLedger& instance() {
+        static BookingLedger ledger;
+        return ledger;
+    }
+
+    // Add (delta 1) or remove (delta -1) a booking in a status on a flight
+    void count(Flight& flight, BookingStatus status, int delta) {
+        double fare = flight.get_base_fare();
+        flight.get_booking_totals().count(status, fare, delta);
+        update(by_route, route_key(flight.get_origin_id(), flight.get_destination_id()), status, fare, delta);
+        update(by_day, day_of(flight.get_departure_minutes()), status, fare, delta);
+    }
+
+    // Drop a flight's totals from the roll-ups, when the flight leaves the calendar
+    void forget_flight(const Flight& flight) {
+        const BookingTotals& totals = flight.get_booking_totals();
+        if (totals.empty()) {
+            return;
+        }
+        auto route = by_route.find(route_key(flight.get_origin_id(), flight.get_destination_id()));
+        if (route != by_route.end()) {
+            route->second.add(totals, -1);
+            if (route->second.empty()) {
+                by_route.erase(route);
+            }
+        }
+        auto day = by_day.find(day_of(flight.get_departure_minutes()));
+        if (day != by_day.end()) {
+            day->second.add(totals, -1);
+            if (day->second.empty()) {
+                by_day.erase(day);
+            }
+        }
+    }
+
+    // Move a flight's bookings to another departure day, after the flight was retimed
+    void move_flight(const Flight& flight, int32_t from_day, int32_t to_day) {
+        if (from_day == to_day || flight.get_booking_totals().empty()) {
+            return;
+        }
+        by_day[from_day].add(flight.get_booking_totals(), -1);
+        if (by_day[from_day].empty()) {
+            by_day.erase(from_day);
+        }
+        by_day[to_day].add(flight.get_booking_totals(), 1);
+    }
+
+    BookingTotals get_route_totals(Symbol origin, Symbol destination) const {
+        auto it = by_route.find(route_key(origin, destination));
+        return it == by_route.end() ? BookingTotals() : it->second;
+    }
+
+    BookingTotals get_day_totals(int32_t day) const {
+        auto it = by_day.find(day);
+        return it == by_day.end() ? BookingTotals() : it->second;
+    }
+
+    // Every route with bookings, as fn(origin, destination, totals)
+    template <typename Fn>
+    void for_each_route(Fn fn) const {
+        for (const auto& entry : by_route) {
+            fn(static_cast<Symbol>(entry.first >> 32), static_cast<Symbol>(entry.first), entry.second);
+        }
+    }
+
+    const map<int32_t, BookingTotals>& get_days() const {
+        return by_day;
+    }
+};
+
+class Itinerary;
+
+// Booking class to manage flight bookings; each booking is linked into its flight's manifest
+class Booking : public ManifestLink {
+private:
+    string booking_id;
+    PassengerRegistry* registry;
+    PassengerHandle passenger;
+    Flight* flight;
+    string seat_number;
+    BookingStatus booking_status;
+    Reservation reservation; // The seat, held while pending and sold once confirmed
+    Itinerary* itinerary; // Itinerary holding the booking, or nullptr; maintained by Itinerary
+    size_t itinerary_slot; // Position in that itinerary
+
+    // Move to a new status, keeping the ledger's totals in step
+    void change_status(BookingStatus status) {
+        BookingLedger::instance().count(*flight, booking_status, -1);
+        booking_status = status;
+        BookingLedger::instance().count(*flight, booking_status, 1);
+    }
+
+    // Reject a change the status state machine does not allow, before anything is journaled
+    void check_status_change(BookingStatus status) const {
+        if (!booking_status_can_change(booking_status, status)) {
+            throw InvalidStatusTransitionException();
+        }
+    }
+
+public:
+    // Constructor to initialize booking details; the seat is reserved through BookingEngine or SeatUnavailableException is thrown.
+    // A booking restored as cancelled holds no seat, since another booking may have taken it since.
+    Booking(const string& booking_id, PassengerRegistry& registry, PassengerHandle passenger, Flight* flight, const string& seat_number, BookingStatus booking_status)
+        : booking_id(booking_id), registry(&registry), passenger(passenger), flight(flight), seat_number(seat_number), booking_status(booking_status),
+          itinerary(nullptr), itinerary_slot(SIZE_MAX) {
+        if (booking_status != BookingStatus::Cancelled && !BookingEngine::instance().reserve(*flight, seat_number, reservation)) {
+            throw SeatUnavailableException();
+        }
+        if (booking_status == BookingStatus::Confirmed) {
+            BookingEngine::instance().confirm(reservation);
+        }
+        flight->link_booking(this);
+        BookingLedger::instance().count(*flight, booking_status, 1);
+    }
+
+    // Bookings are linked into their flight's manifest by address, so they are not copied
+    Booking(const Booking&) = delete;
+    Booking& operator=(const Booking&) = delete;
+
+    // A cancelled booking stays in its flight's cancellation count after it is gone
+    ~Booking() {
+        if (booking_status != BookingStatus::Cancelled) {
+            BookingLedger::instance().count(*flight, booking_status, -1);
+        } else {
+            flight->count_removed_cancellations(1);
+        }
+        flight->unlink_booking(this);
+    }
+
+    // Method to confirm a pending booking; the change is journaled before it is applied.
+    // Throws InvalidStatusTransitionException if the booking is not pending.
+    void confirm_booking() {
+        INSTRUMENT_SCOPE(Probe::ConfirmBooking);
+        check_status_change(BookingStatus::Confirmed);
+        BookingJournal::instance().commit(JournalRecordType::BookingStatusChanged, BookingStatus::Confirmed, { booking_id });
+        restore_status(BookingStatus::Confirmed);
+        flight->notify(flight->make_event(EventKind::BookingConfirmed, get_passenger()->get_name(), booking_status));
+    }
+
+    // Method to cancel booking; the change is journaled before it is applied.
+    // Throws InvalidStatusTransitionException if the booking is already cancelled.
+    void cancel_booking() {
+        check_status_change(BookingStatus::Cancelled);
+        BookingJournal::instance().commit(JournalRecordType::BookingCancelled, BookingStatus::Cancelled, { booking_id });
+        restore_cancelled();
+        flight->notify(flight->make_event(EventKind::BookingCancelled, get_passenger()->get_name(), booking_status));
+    }
+
+    // Apply a replayed status change without journaling it or notifying observers
+    void restore_status(BookingStatus status) {
+        if (status == BookingStatus::Cancelled) {
+            restore_cancelled();
+            return;
+        }
+        change_status(status);
+        if (status == BookingStatus::Confirmed) {
+            BookingEngine::instance().confirm(reservation);
+        }
+    }
+
+    // Apply a replayed cancellation without journaling it or notifying observers
+    void restore_cancelled() {
+        change_status(BookingStatus::Cancelled);
+        BookingEngine::instance().cancel(reservation);
+    }
+
+    // Get flight associated with the booking
+    Flight* get_flight() const {
+        return flight;
+    }
+
+    // Get booking status
+    BookingStatus get_booking_status() const {
+        return booking_status;
+    }
+
+    // Set booking status and notify observers; throws InvalidStatusTransitionException for a change the
+    // state machine does not allow
+    void set_booking_status(BookingStatus status) {
+        if (status == BookingStatus::Cancelled) {
+            cancel_booking(); // Releases the seat as well
+            return;
+        }
+        check_status_change(status);
+        BookingJournal::instance().commit(JournalRecordType::BookingStatusChanged, status, { booking_id });
+        restore_status(status);
+        flight->notify(flight->make_event(EventKind::BookingStatusChanged, get_passenger()->get_name(), status));
+    }
+
+    // Display booking details
+    void get_booking_info() const {
+        string out;
+        append_booking_info(out);
+        cout << out;
+    }
+
+    // Append the booking's details, followed by its flight's, to a report
+    void append_booking_info(string& out) const {
+        out += "Booking ID: ";
+        out += booking_id;
+        out += ", Seat Number: ";
+        out += seat_number;
+        out += ", Status: ";
+        out += booking_status_name(booking_status);
+        out += '\n';
+        flight->append_flight_info(out);
+    }
+
+    // Get booking ID
+    const string& get_booking_id() const {
+        return booking_id;
+    }
+
+    const string& get_seat_number() const {
+        return seat_number;
+    }
+
+    Itinerary* get_itinerary() const {
+        return itinerary;
+    }
+
+    size_t get_itinerary_slot() const {
+        return itinerary_slot;
+    }
+
+    void set_itinerary_slot(Itinerary* owner, size_t slot) {
+        itinerary = owner;
+        itinerary_slot = slot;
+    }
+
+    Passenger* get_passenger() const {
+        return &registry->get(passenger);
+    }
+
+    PassengerHandle get_passenger_handle() const {
+        return passenger;
+    }
+};
+
+// Itinerary class to manage bookings for a passenger
+class Itinerary {
+private:
+    string itinerary_id;
+    // Removed bookings leave a nullptr tombstone so removal is constant time and order is kept
+    vector<Booking*> bookings;
+    size_t tombstones = 0;
+
+    // Drop tombstones and renumber the remaining bookings' slots
+    void compact() {
+        size_t kept = 0;
+        for (auto* booking : bookings) {
+            if (booking) {
+                booking->set_itinerary_slot(this, kept);
+                bookings[kept++] = booking;
+            }
+        }
+        bookings.resize(kept);
+        tombstones = 0;
+    }
+
+public:
+    // Constructor to initialize itinerary details
+    Itinerary(const string& itinerary_id) : itinerary_id(itinerary_id) {}
+
+    const string& get_itinerary_id() const {
+        return itinerary_id;
+    }
+
+    // Bookings in itinerary order; removed entries are nullptr
+    const vector<Booking*>& get_bookings() const {
+        return bookings;
+    }
+
+    // Method to display itinerary details
+    void get_itinerary_details() const {
+        cout << "Itinerary ID: " << itinerary_id << '\n';
+        write_report(bookings.size(), [this](size_t i, string& out) {
+            if (bookings[i]) {
+                bookings[i]->append_booking_info(out);
+            }
+        });
+    }
+
+    // Add booking to itinerary; a booking belongs to one itinerary at a time, so it leaves any other first
+    void add_booking(Booking* booking) {
+        if (booking->get_itinerary()) {
+            booking->get_itinerary()->remove_booking(booking);
+        }
+        BookingJournal::instance().append(JournalRecordType::ItineraryBookingAdded, BookingStatus::Pending,
+                                          { itinerary_id, booking->get_booking_id() });
+        booking->set_itinerary_slot(this, bookings.size());
+        bookings.push_back(booking);
+    }
+
+    // Remove booking from itinerary
+    void remove_booking(Booking* booking) {
+        if (booking->get_itinerary() != this) {
+            return;
+        }
+        BookingJournal::instance().append(JournalRecordType::ItineraryBookingRemoved, BookingStatus::Pending,
+                                          { itinerary_id, booking->get_booking_id() });
+        bookings[booking->get_itinerary_slot()] = nullptr;
+        booking->set_itinerary_slot(nullptr, SIZE_MAX);
+        // Compacting once half the entries are tombstones keeps removal amortized constant time
+        if (++tombstones * 2 > bookings.size()) {
+            compact();
+        }
+    }
+};
+
+// Reference to a booking in a BookingStore; the generation detects handles to removed bookings
+struct BookingHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool is_valid() const { return index != UINT32_MAX; }
+};
+
+// BookingStore class owning all bookings, keyed by booking ID
+class BookingStore {
+private:
+    struct Slot {
+        Booking* booking = nullptr;
+        uint32_t generation = 0;
+        uint32_t dense_index = 0;
+    };
+
+    vector<Slot> slots;
+    vector<uint32_t> free_slots;
+    // Slot numbers of live bookings packed together, so iteration never meets a hole
+    vector<uint32_t> dense;
+    // Keys view the booking_id stored in each Booking
+    unordered_map<string_view, uint32_t> by_id;
+    // Bookings are allocated from a pool; cancelled bookings' memory is reused for new ones
+    ObjectPool<Booking> pool;
+
+public:
+    BookingStore() = default;
+    BookingStore(const BookingStore&) = delete;
+    BookingStore& operator=(const BookingStore&) = delete;
+
+    ~BookingStore() {
+        clear();
+    }
+
+    // Create and store a booking. Returns an invalid handle if the booking ID is taken;
+    // throws SeatUnavailableException if the seat cannot be reserved.
+    // The booking is journaled before it is applied, so it is checked first and nothing is applied if the commit fails.
+    BookingHandle create_booking(const string& booking_id, PassengerRegistry& registry, PassengerHandle passenger, Flight* flight,
+                                 const string& seat_number, BookingStatus booking_status) {
+        INSTRUMENT_SCOPE(Probe::CreateBooking);
+        if (by_id.count(booking_id)) {
+            return BookingHandle();
+        }
+        if (booking_status != BookingStatus::Cancelled) {
+            int seat = flight->get_seat_map().find_seat(seat_number);
+            if (seat < 0 || !flight->get_seat_map().is_free(seat)) {
+                throw SeatUnavailableException();
+            }
+        }
+        BookingJournal::instance().commit(JournalRecordType::BookingCreated, booking_status,
+            { booking_id, registry.get(passenger).get_passport_number(), flight->get_flight_number(),
+              format_date(day_of(flight->get_departure_minutes())), seat_number });
+        Booking* booking = pool.create(booking_id, registry, passenger, flight, seat_number, booking_status);
+        uint32_t index;
+        if (free_slots.empty()) {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        } else {
+            index = free_slots.back();
+            free_slots.pop_back();
+        }
+        Slot& slot = slots[index];
+        slot.booking = booking;
+        slot.dense_index = static_cast<uint32_t>(dense.size());
+        dense.push_back(index);
+        by_id.emplace(booking->get_booking_id(), index);
+        return BookingHandle{ index, slot.generation };
+    }
+
+    // Find a booking by ID, returning an invalid handle if there is none
+    BookingHandle find(string_view booking_id) const {
+        auto it = by_id.find(booking_id);
+        return it == by_id.end() ? BookingHandle() : BookingHandle{ it->second, slots[it->second].generation };
+    }
+
+    // Resolve a handle, returning nullptr if the booking has been removed
+    Booking* get(BookingHandle handle) const {
+        if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) {
+            return nullptr;
+        }
+        return slots[handle.index].booking;
+    }
+
+    // Remove and destroy a booking in constant time, taking it out of its itinerary; stale handles are ignored
+    bool remove(BookingHandle handle) {
+        Booking* booking = get(handle);
+        if (!booking) {
+            return false;
+        }
+        if (booking->get_itinerary()) {
+            booking->get_itinerary()->remove_booking(booking);
+        }
+        BookingJournal::instance().commit(JournalRecordType::BookingRemoved, booking->get_booking_status(), { booking->get_booking_id() });
+        Slot& slot = slots[handle.index];
+        by_id.erase(booking->get_booking_id());
+        // Swap-and-pop the dense array, pointing the moved slot at its new position
+        uint32_t moved = dense.back();
+        dense[slot.dense_index] = moved;
+        slots[moved].dense_index = slot.dense_index;
+        dense.pop_back();
+        pool.destroy(booking);
+        slot.booking = nullptr;
+        ++slot.generation; // Invalidates every outstanding handle to this slot
+        free_slots.push_back(handle.index);
+        return true;
+    }
+
+    // Destroy every booking; call before the flights they reference are deleted
+    void clear() {
+        for (uint32_t index : dense) {
+            pool.destroy(slots[index].booking);
+            slots[index].booking = nullptr;
+            ++slots[index].generation;
+            free_slots.push_back(index);
+        }
+        dense.clear();
+        by_id.clear();
+    }
+
+    size_t size() const {
+        return dense.size();
+    }
+
+    // Live bookings by position, 0 <= i < size(); positions change when bookings are removed
+    Booking* at(size_t i) const {
+        return slots[dense[i]].booking;
+    }
+};
+
+// FlightIndex class mapping flight numbers to flights with open addressing
+class FlightIndex {
+private:
+    // A slot is empty when flight is nullptr and not deleted, a tombstone when deleted
+    struct Slot {
+        Symbol flight_number = 0;
+        Flight* flight = nullptr;
+        bool deleted = false;
+    };
+
+    vector<Slot> slots;
+    size_t live_count = 0;
+    size_t used_count = 0; // live entries plus tombstones
+
+    // Symbols are sequential, so mix the bits before masking to spread neighbours apart
+    static size_t hash_of(Symbol flight_number) {
+        return static_cast<size_t>(flight_number * 0x9E3779B1u);
+    }
+
+    // Rebuild the table with the given capacity (a power of two), dropping tombstones
+    void rehash(size_t capacity) {
+        vector<Slot> old_slots(capacity);
+        old_slots.swap(slots);
+        live_count = 0;
+        used_count = 0;
+        for (const auto& slot : old_slots) {
+            if (slot.flight && !slot.deleted) {
+                place(slot.flight_number, slot.flight);
+            }
+        }
+    }
+
+    // Put a flight into the first free slot of its probe sequence
+    void place(Symbol flight_number, Flight* flight) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash_of(flight_number) & mask;; i = (i + 1) & mask) {
+            if (!slots[i].flight) {
+                slots[i].flight_number = flight_number;
+                slots[i].flight = flight;
+                slots[i].deleted = false;
+                ++live_count;
+                ++used_count;
+                return;
+            }
+        }
+    }
+
+    // Find the slot holding a flight number, or nullptr if absent
+    const Slot* find_slot(Symbol flight_number) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash_of(flight_number) & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (!slot.flight && !slot.deleted) {
+                return nullptr;
+            }
+            if (!slot.deleted && slot.flight_number == flight_number) {
+                return &slot;
+            }
+        }
+    }
+
+public:
+    FlightIndex() : slots(16) {}
+
+    // Index a flight; the first flight added under a number wins, as with a front-to-back scan
+    void insert(Flight* flight) {
+        if (find(flight->get_flight_number_id())) {
+            return;
+        }
+        // Keep the load factor (counting tombstones) under 0.75 so probe sequences stay short
+        if ((used_count + 1) * 4 > slots.size() * 3) {
+            rehash(live_count * 2 >= slots.size() ? slots.size() * 2 : slots.size());
+        }
+        place(flight->get_flight_number_id(), flight);
+    }
+
+    // Remove the entry for a flight number, leaving a tombstone
+    void erase(Symbol flight_number) {
+        Slot* slot = const_cast<Slot*>(find_slot(flight_number));
+        if (slot) {
+            slot->deleted = true;
+            --live_count;
+        }
+    }
+
+    // Look up a flight by number, returning nullptr if it is not indexed
+    Flight* find(Symbol flight_number) const {
+        const Slot* slot = find_slot(flight_number);
+        return slot ? slot->flight : nullptr;
+    }
+};
+
+// View over a contiguous run of flights owned by a Schedule
+struct FlightRange {
+    vector<Flight*>::const_iterator first;
+    vector<Flight*>::const_iterator last;
+
+    vector<Flight*>::const_iterator begin() const { return first; }
+    vector<Flight*>::const_iterator end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// Schedule class to manage flights on a specific date
+class Schedule {
+private:
+    string schedule_id;
+    string date;
+    vector<Flight*> flights;
+    // The same flights partitioned by kind, so per-kind passes need no type tests
+    vector<DomesticFlight*> domestic_flights;
+    vector<InternationalFlight*> international_flights;
+    FlightIndex flight_index;
+    // Flights ordered by departure time, for binary-searched time-window queries
+    vector<Flight*> by_departure;
+
+    static bool departs_before(const Flight* flight, int32_t minutes) {
+        return flight->get_departure_minutes() < minutes;
+    }
+
+    void add_to_partition(Flight* flight) {
+        if (flight->get_flight_type() == FlightType::Domestic) {
+            domestic_flights.push_back(static_cast<DomesticFlight*>(flight));
+        } else {
+            international_flights.push_back(static_cast<InternationalFlight*>(flight));
+        }
+    }
+
+    void remove_from_partition(Flight* flight) {
+        if (flight->get_flight_type() == FlightType::Domestic) {
+            domestic_flights.erase(remove(domestic_flights.begin(), domestic_flights.end(), flight), domestic_flights.end());
+        } else {
+            international_flights.erase(remove(international_flights.begin(), international_flights.end(), flight), international_flights.end());
+        }
+    }
+
+public:
+    // Constructor to initialize schedule details
+    Schedule(const string& schedule_id, const string& date)
+        : schedule_id(schedule_id), date(date) {}
+
+    const string& get_schedule_id() const {
+        return schedule_id;
+    }
+
+    const string& get_date() const {
+        return date;
+    }
+
+    // Add flight to schedule
+    void add_flight(Flight* flight) {
+        flights.push_back(flight);
+        add_to_partition(flight);
+        flight_index.insert(flight);
+        // Insert after flights with the same departure so ties keep schedule order
+        auto position = upper_bound(by_departure.begin(), by_departure.end(), flight->get_departure_minutes(),
+            [](int32_t minutes, const Flight* other) { return minutes < other->get_departure_minutes(); });
+        by_departure.insert(position, flight);
+    }
+
+    // Add many flights at once, sorting them into departure order in one pass instead of one insert each
+    void add_flights(const vector<Flight*>& new_flights) {
+        size_t old_count = by_departure.size();
+        flights.insert(flights.end(), new_flights.begin(), new_flights.end());
+        by_departure.insert(by_departure.end(), new_flights.begin(), new_flights.end());
+        for (auto* flight : new_flights) {
+            add_to_partition(flight);
+            flight_index.insert(flight);
+        }
+        auto departs_earlier = [](const Flight* a, const Flight* b) { return a->get_departure_minutes() < b->get_departure_minutes(); };
+        stable_sort(by_departure.begin() + old_count, by_departure.end(), departs_earlier);
+        inplace_merge(by_departure.begin(), by_departure.begin() + old_count, by_departure.end(), departs_earlier);
+    }
+
+    // Remove flight from schedule
+    void remove_flight(Flight* flight) {
+        flights.erase(remove(flights.begin(), flights.end(), flight), flights.end());
+        remove_from_partition(flight);
+        auto first = lower_bound(by_departure.begin(), by_departure.end(), flight->get_departure_minutes(), departs_before);
+        auto last = first;
+        while (last != by_departure.end() && (*last)->get_departure_minutes() == flight->get_departure_minutes()) {
+            ++last;
+        }
+        by_departure.erase(remove(first, last, flight), last);
+        if (flight_index.find(flight->get_flight_number_id()) == flight) {
+            flight_index.erase(flight->get_flight_number_id());
+            // Another flight may share the number; index the next one in schedule order
+            for (auto* other : flights) {
+                if (other->get_flight_number_id() == flight->get_flight_number_id()) {
+                    flight_index.insert(other);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Display schedule details
+    void get_schedule_details() const {
+        string out;
+        append_schedule_details(out);
+        cout << out;
+    }
+
+    // Append the schedule's details to a report
+    void append_schedule_details(string& out) const {
+        out += "Schedule ID: ";
+        out += schedule_id;
+        out += ", Date: ";
+        out += date;
+        out += '\n';
+        for (const auto& flight : flights) {
+            flight->append_flight_info(out);
+        }
+    }
+
+    const vector<Flight*>& get_flights() const {
+        return flights;
+    }
+
+    // Flights of one kind, in schedule order
+    template <FlightType Kind>
+    const vector<TypedFlight<Kind>*>& get_flights_of_kind() const {
+        if constexpr (Kind == FlightType::Domestic) {
+            return domestic_flights;
+        } else {
+            return international_flights;
+        }
+    }
+
+    // Flights ordered by departure time
+    const vector<Flight*>& get_flights_by_departure() const {
+        return by_departure;
+    }
+
+    // Flights departing in [from_minutes, to_minutes), in departure order
+    FlightRange flights_departing_between(int32_t from_minutes, int32_t to_minutes) const {
+        auto first = lower_bound(by_departure.begin(), by_departure.end(), from_minutes, departs_before);
+        auto last = lower_bound(first, by_departure.end(), max(from_minutes, to_minutes), departs_before);
+        return FlightRange{ first, last };
+    }
+
+    // Find a flight by number through the hash index, or nullptr if not scheduled
+    Flight* find_flight(string_view flight_number) const {
+        INSTRUMENT_SCOPE(Probe::FindFlight);
+        Symbol symbol;
+        return SymbolTable::instance().find(flight_number, symbol) ? flight_index.find(symbol) : nullptr;
+    }
+};
+
+// Weekday masks for RecurringFlight; bit d stands for weekday d, with 0 for Sunday
+const uint8_t every_day = 0x7F;
+const uint8_t daily_except_sunday = 0x7E;
+
+// Flight operating on a weekly pattern over a period of days. ScheduleCalendar turns it into a
+// concrete flight on an operating day only when that day is first used.
+struct RecurringFlight {
+    FlightType flight_type;
+    string flight_number;
+    string origin;
+    string destination;
+    int32_t departure_minute_of_day; // Minutes after midnight
+    int32_t duration_minutes;
+    uint8_t weekdays;
+    int32_t first_day;               // Operating period as day numbers, both inclusive
+    int32_t last_day;
+    vector<int32_t> cancelled_days = {}; // Sorted days of the period whose leg was cancelled or moved to another day
+
+    bool operates_on(int32_t day) const {
+        int weekday = ((day + 4) % 7 + 7) % 7; // 1970-01-01 was a Thursday
+        return day >= first_day && day <= last_day && (weekdays >> weekday & 1) &&
+               !binary_search(cancelled_days.begin(), cancelled_days.end(), day);
+    }
+};
+
+// One flight as a published schedule version saw it. The names view SymbolTable strings, which never move or
+// change, and the times are copied, so a retiming publishes a new leg rather than changing one a reader holds.
+struct ScheduleLeg {
+    Flight* flight; // Live seat map and bookings; freed only once no reader of this version remains
+    string_view flight_number;
+    string_view origin;
+    string_view destination;
+    int32_t departure_minutes;
+    int32_t arrival_minutes;
+    FlightType flight_type;
+
+    static ScheduleLeg of(Flight* flight) {
+        return ScheduleLeg{ flight, flight->get_flight_number(), flight->get_origin(), flight->get_destination(),
+                            flight->get_departure_minutes(), flight->get_arrival_minutes(), flight->get_flight_type() };
+    }
+
+    void append_leg_info(string& out) const {
+        Flight::append_flight_info(out, flight_number, origin, destination, departure_minutes, arrival_minutes);
+    }
+};
+
+// ScheduleSnapshot class holding an immutable version of one day's schedule, for lock-free readers
+class ScheduleSnapshot {
+private:
+    string schedule_id;
+    string date;
+    uint64_t version;
+    vector<ScheduleLeg> legs;  // In departure order
+    vector<uint32_t> by_number; // Leg positions ordered by flight number, then departure
+
+public:
+    ScheduleSnapshot(const Schedule& schedule, uint64_t version)
+        : schedule_id(schedule.get_schedule_id()), date(schedule.get_date()), version(version) {
+        legs.reserve(schedule.get_flights_by_departure().size());
+        for (auto* flight : schedule.get_flights_by_departure()) {
+            legs.push_back(ScheduleLeg::of(flight));
+        }
+        by_number.resize(legs.size());
+        for (uint32_t i = 0; i < by_number.size(); ++i) {
+            by_number[i] = i;
+        }
+        stable_sort(by_number.begin(), by_number.end(), [this](uint32_t a, uint32_t b) {
+            return legs[a].flight_number < legs[b].flight_number;
+        });
+    }
+
+    uint64_t get_version() const {
+        return version;
+    }
+
+    const vector<ScheduleLeg>& get_legs() const {
+        return legs;
+    }
+
+    // The earliest leg with a flight number, or nullptr
+    const ScheduleLeg* find_leg(string_view flight_number) const {
+        auto it = lower_bound(by_number.begin(), by_number.end(), flight_number, [this](uint32_t i, string_view number) {
+            return legs[i].flight_number < number;
+        });
+        return it != by_number.end() && legs[*it].flight_number == flight_number ? &legs[*it] : nullptr;
+    }
+
+    // Append the schedule's details, listing legs in departure order
+    void append_schedule_details(string& out) const {
+        out += "Schedule ID: ";
+        out += schedule_id;
+        out += ", Date: ";
+        out += date;
+        out += '\n';
+        for (const auto& leg : legs) {
+            leg.append_leg_info(out);
+        }
+    }
+};
+
+// Immutable version of a whole calendar: each day's schedule version, shared with the versions before it
+// when the day did not change, plus the recurring flights that expand into days not yet in use
+struct CalendarSnapshot {
+    uint64_t version = 0;
+    int32_t first_kept_day = INT32_MIN;
+    vector<pair<int32_t, shared_ptr<const ScheduleSnapshot>>> days; // Sorted by day
+    shared_ptr<const vector<RecurringFlight>> recurring_flights;
+
+    // A day's schedule version, or nullptr if the day has no flights or is not in use yet
+    const ScheduleSnapshot* find_day(int32_t day) const {
+        auto it = lower_bound(days.begin(), days.end(), day, [](const pair<int32_t, shared_ptr<const ScheduleSnapshot>>& entry, int32_t d) {
+            return entry.first < d;
+        });
+        return it != days.end() && it->first == day ? it->second.get() : nullptr;
+    }
+
+    // Whether a writer has to put a day in use before readers can see its recurring flights
+    bool needs_expansion(int32_t day) const {
+        if (day < first_kept_day || find_day(day)) {
+            return false;
+        }
+        for (const auto& recurring : *recurring_flights) {
+            if (recurring.operates_on(day)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether any day with departure times in [from_minutes, to_minutes) needs expanding
+    bool range_needs_expansion(int32_t from_minutes, int32_t to_minutes) const {
+        for (int32_t day = day_of(from_minutes); to_minutes > from_minutes && day <= day_of(to_minutes - 1); ++day) {
+            if (needs_expansion(day)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Legs departing in [from_minutes, to_minutes), in departure order. Days not in use are skipped, so a
+    // writer should expand the range first.
+    vector<ScheduleLeg> legs_departing_between(int32_t from_minutes, int32_t to_minutes) const {
+        vector<ScheduleLeg> result;
+        auto it = lower_bound(days.begin(), days.end(), day_of(from_minutes), [](const pair<int32_t, shared_ptr<const ScheduleSnapshot>>& entry, int32_t d) {
+            return entry.first < d;
+        });
+        for (; it != days.end() && it->first * 1440 < to_minutes; ++it) {
+            // Every leg of a day departs that day, so days in order give legs in order
+            for (const auto& leg : it->second->get_legs()) {
+                if (leg.departure_minutes >= from_minutes && leg.departure_minutes < to_minutes) {
+                    result.push_back(leg);
+                }
+            }
+        }
+        return result;
+    }
+};
+
+// ScheduleCalendar class sharding flights by the day they depart. Each day is its own Schedule with its
+// own indexes, created on first use, and recurring flights are expanded into a day only then, so a long
+// forward schedule costs memory only for days that are used. Days before the eviction horizon are
+// dropped for good. The calendar owns its flights.
+// Writers, one at a time, change the Schedules in place and then publish a CalendarSnapshot through an
+// atomic pointer. Readers inside an EpochGuard use the published version without locks; only the days that
+// changed are rebuilt, and replaced versions and removed flights are freed once no reader can see them.
+class ScheduleCalendar {
+private:
+    string calendar_id;
+    map<int32_t, unique_ptr<Schedule>> days;
+    vector<RecurringFlight> recurring_flights;
+    int32_t first_kept_day = INT32_MIN;
+
+    atomic<const CalendarSnapshot*> published;
+    set<int32_t> changed_days; // Days changed since the last publish
+    bool recurring_changed = true;
+
+    // Add a recurring flight's leg to a day it operates on, unless the day already has that flight number
+    static void expand(const RecurringFlight& recurring, int32_t day, Schedule& schedule) {
+        if (!recurring.operates_on(day) || schedule.find_flight(recurring.flight_number)) {
+            return;
+        }
+        int32_t departure = day * 1440 + recurring.departure_minute_of_day;
+        schedule.add_flight(FlightFactory::create_flight(recurring.flight_type, recurring.flight_number, recurring.origin,
+                                                         recurring.destination, departure, departure + recurring.duration_minutes));
+    }
+
+    // An existing day, or a new one if a recurring flight operates on it; nullptr for days with no flights
+    Schedule* find_or_expand_day(int32_t day) {
+        auto it = days.find(day);
+        if (it != days.end()) {
+            return it->second.get();
+        }
+        return needs_expansion(day) ? get_day(day) : nullptr;
+    }
+
+    // The schedule of a day, created with its recurring flights on first use; nullptr if the day was evicted
+    Schedule* get_day(int32_t day) {
+        if (is_evicted(day)) {
+            return nullptr;
+        }
+        auto it = days.find(day);
+        if (it != days.end()) {
+            return it->second.get();
+        }
+        unique_ptr<Schedule> schedule(new Schedule(calendar_id, format_date(day)));
+        for (const auto& recurring : recurring_flights) {
+            expand(recurring, day, *schedule);
+        }
+        changed_days.insert(day);
+        return days.emplace(day, move(schedule)).first->second.get();
+    }
+
+    // Stop a recurring flight from creating its leg on a day, once that leg was cancelled or moved away
+    void drop_recurring_leg(string_view flight_number, int32_t day) {
+        for (auto& recurring : recurring_flights) {
+            if (recurring.flight_number == flight_number && recurring.operates_on(day)) {
+                recurring.cancelled_days.insert(upper_bound(recurring.cancelled_days.begin(), recurring.cancelled_days.end(), day), day);
+                recurring_changed = true;
+            }
+        }
+    }
+
+    // Remove a flight that is out of every schedule and has no bookings. Queued notifications may still name
+    // it and readers of older versions may still see it, so it is freed once both are done with it.
+    void retire_flight(Flight* flight) {
+        BookingLedger::instance().forget_flight(*flight);
+        NotificationDispatcher::instance().drain();
+        EpochManager::instance().retire([flight] { FlightFactory::destroy_flight(flight); });
+    }
+
+    // Publish the days changed since the last publish as a new version. The directory is copied, but the
+    // versions of unchanged days are shared with the previous one.
+    void publish() {
+        const CalendarSnapshot* previous = published.load(memory_order_relaxed);
+        if (previous && changed_days.empty() && !recurring_changed && previous->first_kept_day == first_kept_day) {
+            return;
+        }
+        CalendarSnapshot* next = new CalendarSnapshot();
+        next->version = previous ? previous->version + 1 : 1;
+        next->first_kept_day = first_kept_day;
+        next->recurring_flights = recurring_changed || !previous ? make_shared<const vector<RecurringFlight>>(recurring_flights)
+                                                                 : previous->recurring_flights;
+        next->days.reserve(days.size());
+        size_t p = 0;
+        for (const auto& entry : days) {
+            while (previous && p < previous->days.size() && previous->days[p].first < entry.first) {
+                ++p;
+            }
+            if (previous && p < previous->days.size() && previous->days[p].first == entry.first && !changed_days.count(entry.first)) {
+                next->days.push_back(previous->days[p]);
+            } else {
+                next->days.emplace_back(entry.first, make_shared<const ScheduleSnapshot>(*entry.second, next->version));
+            }
+        }
+        changed_days.clear();
+        recurring_changed = false;
+        published.store(next, memory_order_seq_cst);
+        if (previous) {
+            EpochManager::instance().retire([previous] { delete previous; });
+        }
+    }
+
+public:
+    explicit ScheduleCalendar(const string& calendar_id) : calendar_id(calendar_id), published(nullptr) {
+        publish();
+    }
+
+    ScheduleCalendar(const ScheduleCalendar&) = delete;
+    ScheduleCalendar& operator=(const ScheduleCalendar&) = delete;
+
+    // Bookings on the calendar's flights must be destroyed first, and no reader may be left
+    ~ScheduleCalendar() {
+        EpochManager::instance().synchronize();
+        delete published.load();
+        for (auto& entry : days) {
+            for (auto* flight : entry.second->get_flights()) {
+                BookingLedger::instance().forget_flight(*flight);
+                FlightFactory::destroy_flight(flight);
+            }
+        }
+    }
+
+    const string& get_calendar_id() const {
+        return calendar_id;
+    }
+
+    const vector<RecurringFlight>& get_recurring_flights() const {
+        return recurring_flights;
+    }
+
+    int32_t get_first_kept_day() const {
+        return first_kept_day;
+    }
+
+    // Set the eviction horizon of an empty calendar, as loaders do
+    void restore_first_kept_day(int32_t day) {
+        first_kept_day = day;
+        publish();
+    }
+
+    // The newest published version. Use it only inside an EpochGuard, which keeps it and the flights it
+    // names alive; writers never change a published version.
+    const CalendarSnapshot& get_snapshot() const {
+        return *published.load(memory_order_seq_cst);
+    }
+
+    bool is_evicted(int32_t day) const {
+        return day < first_kept_day;
+    }
+
+    size_t get_day_count() const {
+        return days.size();
+    }
+
+    // Whether the first use of a day will create it, because a recurring flight operates on it
+    bool needs_expansion(int32_t day) const {
+        if (is_evicted(day) || days.count(day)) {
+            return false;
+        }
+        for (const auto& recurring : recurring_flights) {
+            if (recurring.operates_on(day)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Put the days a range of departure times covers in use, so published versions show their recurring flights
+    void expand_range(int32_t from_minutes, int32_t to_minutes) {
+        if (to_minutes > from_minutes) {
+            for (int32_t day = max(day_of(from_minutes), first_kept_day); day <= day_of(to_minutes - 1); ++day) {
+                find_or_expand_day(day);
+            }
+        }
+        publish();
+    }
+
+    // Add a flight to the day it departs. Returns false, leaving the flight with the caller, if that day was evicted.
+    bool add_flight(Flight* flight) {
+        int32_t day = day_of(flight->get_departure_minutes());
+        Schedule* schedule = get_day(day);
+        if (!schedule) {
+            return false;
+        }
+        schedule->add_flight(flight);
+        changed_days.insert(day);
+        publish();
+        return true;
+    }
+
+    // Add many flights, none of them on an evicted day, handing each day its flights in one batch
+    void add_flights(vector<Flight*> new_flights) {
+        stable_sort(new_flights.begin(), new_flights.end(), [](const Flight* a, const Flight* b) {
+            return day_of(a->get_departure_minutes()) < day_of(b->get_departure_minutes());
+        });
+        vector<Flight*> batch;
+        for (size_t i = 0; i < new_flights.size(); ++i) {
+            batch.push_back(new_flights[i]);
+            int32_t day = day_of(new_flights[i]->get_departure_minutes());
+            if (i + 1 == new_flights.size() || day_of(new_flights[i + 1]->get_departure_minutes()) != day) {
+                get_day(day)->add_flights(batch);
+                changed_days.insert(day);
+                batch.clear();
+            }
+        }
+        publish();
+    }
+
+    // Add a recurring flight; days already in use get their leg now, other days when first used
+    void add_recurring_flight(const RecurringFlight& recurring) {
+        recurring_flights.push_back(recurring);
+        recurring_changed = true;
+        for (auto it = days.lower_bound(recurring.first_day); it != days.end() && it->first <= recurring.last_day; ++it) {
+            expand(recurring, it->first, *it->second);
+            changed_days.insert(it->first);
+        }
+        publish();
+    }
+
+    // Find the flight with a number departing on a day, or nullptr
+    Flight* find_flight(string_view flight_number, int32_t day) {
+        Schedule* schedule = is_evicted(day) ? nullptr : find_or_expand_day(day);
+        publish();
+        return schedule ? schedule->find_flight(flight_number) : nullptr;
+    }
+
+    // Move the flight with a number departing on a day to new times and publish the change. Returns the flight,
+    // or nullptr if there is no such flight, the new day was evicted, or another flight with the number departs
+    // on the new day. Throws InvalidFlightTimeException if it would arrive before it departs.
+    Flight* retime_flight(string_view flight_number, int32_t day, int32_t departure_minutes, int32_t arrival_minutes) {
+        if (arrival_minutes < departure_minutes) {
+            throw InvalidFlightTimeException();
+        }
+        Schedule* schedule = is_evicted(day) ? nullptr : find_or_expand_day(day);
+        Flight* flight = schedule ? schedule->find_flight(flight_number) : nullptr;
+        int32_t new_day = day_of(departure_minutes);
+        Schedule* target = !flight || new_day == day ? schedule : get_day(new_day);
+        if (!flight || !target || (target != schedule && target->find_flight(flight_number))) {
+            publish();
+            return nullptr;
+        }
+        BookingJournal::instance().commit(JournalRecordType::FlightRetimed, BookingStatus::Pending,
+            { flight_number, format_date(day), format_timestamp(departure_minutes), format_timestamp(arrival_minutes) });
+        schedule->remove_flight(flight);
+        flight->retime(departure_minutes, arrival_minutes);
+        BookingLedger::instance().move_flight(*flight, day, new_day);
+        target->add_flight(flight);
+        if (new_day != day) {
+            drop_recurring_leg(flight_number, day);
+        }
+        changed_days.insert(day);
+        changed_days.insert(new_day);
+        publish();
+        return flight;
+    }
+
+    // Cancel the flight with a number departing on a day: its bookings are cancelled, notifying their
+    // passengers, and it leaves the schedule. Returns false if there is no such flight.
+    bool cancel_flight(string_view flight_number, int32_t day, BookingStore& bookings) {
+        Schedule* schedule = is_evicted(day) ? nullptr : find_or_expand_day(day);
+        Flight* flight = schedule ? schedule->find_flight(flight_number) : nullptr;
+        if (!flight) {
+            publish();
+            return false;
+        }
+        while (flight->get_booking_count()) {
+            Booking* booking = const_cast<Booking*>(static_cast<const Booking*>(flight->manifest_begin()));
+            if (booking->get_booking_status() != BookingStatus::Cancelled) {
+                booking->cancel_booking();
+            }
+            flight->detach(booking->get_passenger());
+            bookings.remove(bookings.find(booking->get_booking_id()));
+        }
+        BookingJournal::instance().commit(JournalRecordType::FlightCancelled, BookingStatus::Pending, { flight_number, format_date(day) });
+        schedule->remove_flight(flight);
+        drop_recurring_leg(flight_number, day);
+        changed_days.insert(day);
+        publish();
+        retire_flight(flight);
+        return true;
+    }
+
+    // Flights departing in [from_minutes, to_minutes), in departure order, expanding the days the range covers
+    vector<Flight*> flights_departing_between(int32_t from_minutes, int32_t to_minutes) {
+        vector<Flight*> result;
+        if (to_minutes <= from_minutes) {
+            return result;
+        }
+        expand_range(from_minutes, to_minutes);
+        int32_t first_day = max(day_of(from_minutes), first_kept_day);
+        int32_t last_day = day_of(to_minutes - 1);
+        for (auto it = days.lower_bound(first_day); it != days.end() && it->first <= last_day; ++it) {
+            FlightRange range = it->second->flights_departing_between(from_minutes, to_minutes);
+            result.insert(result.end(), range.begin(), range.end());
+        }
+        return result;
+    }
+
+    // Call function on each day in use, in date order
+    template <typename Function>
+    void for_each_day(Function function) const {
+        for (const auto& entry : days) {
+            function(*entry.second);
+        }
+    }
+
+    // Call function on each flight of one kind in the days in use, day by day
+    template <FlightType Kind, typename Function>
+    void for_each_flight_of_kind(Function function) const {
+        for (const auto& entry : days) {
+            for (auto* flight : entry.second->get_flights_of_kind<Kind>()) {
+                function(flight);
+            }
+        }
+    }
+
+    // Display every day in use, rendering the days in parallel
+    void get_calendar_details() const {
+        vector<const Schedule*> schedules;
+        for_each_day([&schedules](const Schedule& schedule) { schedules.push_back(&schedule); });
+        write_report(schedules.size(), [&schedules](size_t i, string& out) { schedules[i]->append_schedule_details(out); });
+    }
+
+    // Drop every day before first_day together with the bookings on its flights, and stop creating those days.
+    // Returns the number of days dropped.
+    size_t evict_before(int32_t first_day, BookingStore& bookings) {
+        size_t evicted = 0;
+        vector<Flight*> removed;
+        for (auto it = days.begin(); it != days.end() && it->first < first_day; it = days.erase(it)) {
+            for (auto* flight : it->second->get_flights()) {
+                while (flight->get_booking_count()) {
+                    Booking* booking = const_cast<Booking*>(static_cast<const Booking*>(flight->manifest_begin()));
+                    flight->detach(booking->get_passenger());
+                    bookings.remove(bookings.find(booking->get_booking_id()));
+                }
+                removed.push_back(flight);
+            }
+            ++evicted;
+        }
+        if (first_day > first_kept_day) {
+            first_kept_day = first_day;
+            BookingJournal::instance().commit(JournalRecordType::DaysEvicted, BookingStatus::Pending, { format_date(first_day) });
+        }
+        publish();
+        for (auto* flight : removed) {
+            retire_flight(flight);
+        }
+        return evicted;
+    }
+};
+
+// Function to find a flight by flight number and departure day in a calendar
+Flight* find_flight_by_number(ScheduleCalendar& calendar, const string& flight_number, int32_t day) {
+    Flight* flight = calendar.find_flight(flight_number, day);
+    if (flight) {
+        return flight;
+    }
+    throw FlightNotFoundException();
+}
+
+// FlightTable class storing flights column by column for bulk scans
+class FlightTable {
+private:
+    // Each column holds one field for every row, so a sweep over one field reads contiguous memory
+    vector<Symbol> flight_numbers;
+    vector<Symbol> origins;
+    vector<Symbol> destinations;
+    vector<int32_t> departures;
+    vector<int32_t> arrivals;
+    vector<FlightType> types;
+    vector<double> load_factors; // Occupied share of seats, 0 to 1
+    vector<double> fares;        // Zero until a FareEngine prices the row
+
+public:
+    // Append a row and return its index
+    uint32_t add_flight(FlightType type, Symbol flight_number, Symbol origin, Symbol destination,
+                        int32_t departure_minutes, int32_t arrival_minutes, double load_factor) {
+        flight_numbers.push_back(flight_number);
+        origins.push_back(origin);
+        destinations.push_back(destination);
+        departures.push_back(departure_minutes);
+        arrivals.push_back(arrival_minutes);
+        types.push_back(type);
+        load_factors.push_back(load_factor);
+        fares.push_back(0.0);
+        return static_cast<uint32_t>(flight_numbers.size() - 1);
+    }
+
+    // Append every flight of a schedule
+    void add_schedule(const Schedule& schedule) {
+        reserve(size() + schedule.get_flights().size());
+        for (auto* flight : schedule.get_flights()) {
+            const SeatMap& seats = flight->get_seat_map();
+            add_flight(flight->get_flight_type(), flight->get_flight_number_id(), flight->get_origin_id(), flight->get_destination_id(),
+                       flight->get_departure_minutes(), flight->get_arrival_minutes(),
+                       static_cast<double>(seats.get_occupied_seats()) / seats.get_total_seats());
+        }
+    }
+
+    void reserve(size_t rows) {
+        flight_numbers.reserve(rows);
+        origins.reserve(rows);
+        destinations.reserve(rows);
+        departures.reserve(rows);
+        arrivals.reserve(rows);
+        types.reserve(rows);
+        load_factors.reserve(rows);
+        fares.reserve(rows);
+    }
+
+    size_t size() const {
+        return flight_numbers.size();
+    }
+
+    // Rows of the given flight type
+    vector<uint32_t> select_by_type(FlightType type) const {
+        vector<uint32_t> rows;
+        for (uint32_t i = 0; i < types.size(); ++i) {
+            if (types[i] == type) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    }
+
+    // Rows flying from origin to destination
+    vector<uint32_t> select_by_route(Symbol origin, Symbol destination) const {
+        vector<uint32_t> rows;
+        for (uint32_t i = 0; i < origins.size(); ++i) {
+            if (origins[i] == origin && destinations[i] == destination) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    }
+
+    Symbol get_flight_number(uint32_t row) const { return flight_numbers[row]; }
+    Symbol get_origin(uint32_t row) const { return origins[row]; }
+    Symbol get_destination(uint32_t row) const { return destinations[row]; }
+    int32_t get_departure_minutes(uint32_t row) const { return departures[row]; }
+    int32_t get_arrival_minutes(uint32_t row) const { return arrivals[row]; }
+    FlightType get_flight_type(uint32_t row) const { return types[row]; }
+    double get_load_factor(uint32_t row) const { return load_factors[row]; }
+    double get_fare(uint32_t row) const { return fares[row]; }
+    void set_load_factor(uint32_t row, double load_factor) { load_factors[row] = load_factor; }
+    void set_fare(uint32_t row, double fare) { fares[row] = fare; }
+
+    // Whole columns, for batch passes such as repricing
+    const vector<int32_t>& get_departure_column() const { return departures; }
+    const vector<int32_t>& get_arrival_column() const { return arrivals; }
+    const vector<FlightType>& get_flight_type_column() const { return types; }
+    const vector<double>& get_load_factor_column() const { return load_factors; }
+    vector<double>& get_fare_column() { return fares; }
+};
+
+enum class CabinClass : uint8_t {
+    Economy,
+    Business
+};
+
+// Pricing rules applied by FareEngine. A fare is
+//   (base fare of the flight type + hourly rate * flight hours) * cabin multiplier
+//   * multiplier of the load-factor band reached * multiplier of the advance-purchase band reached.
+// Unused bands have thresholds that are never reached. The defaults are each kind's base fare.
+struct FareRules {
+    static constexpr size_t max_bands = 4;
+
+    double base_fares[2] = { FlightKind<FlightType::Domestic>::base_fare,       // Indexed by FlightType
+                             FlightKind<FlightType::International>::base_fare };
+    double hourly_rate = 0.0;
+    double cabin_multipliers[2] = { 1.0, 1.0 }; // Indexed by CabinClass
+    // Load-factor bands in increasing order: band i applies once the load factor reaches load_thresholds[i]
+    double load_thresholds[max_bands] = { 2.0, 2.0, 2.0, 2.0 };
+    double load_multipliers[max_bands] = { 1.0, 1.0, 1.0, 1.0 };
+    // Advance-purchase bands in decreasing order: band i applies when buying at most advance_days[i] days ahead
+    double advance_days[max_bands] = { -1e9, -1e9, -1e9, -1e9 };
+    double advance_multipliers[max_bands] = { 1.0, 1.0, 1.0, 1.0 };
+};
+
+// FareEngine class pricing flights from FareRules. Repricing runs over FlightTable columns in one
+// branch-free loop, which the compiler vectorizes, instead of a virtual call per flight.
+class FareEngine {
+private:
+    FareRules rules;
+
+    // Fare of one flight; bands are chosen with selects rather than branches so the batch loop vectorizes
+    static double fare_for(const FareRules& rules, double type_index, double flight_minutes, double load_factor,
+                           double days_ahead, double cabin_multiplier) {
+        double base = rules.base_fares[0] + (rules.base_fares[1] - rules.base_fares[0]) * type_index;
+        double load_multiplier = 1.0;
+        double advance_multiplier = 1.0;
+        for (size_t band = 0; band < FareRules::max_bands; ++band) {
+            load_multiplier = load_factor >= rules.load_thresholds[band] ? rules.load_multipliers[band] : load_multiplier;
+            advance_multiplier = days_ahead <= rules.advance_days[band] ? rules.advance_multipliers[band] : advance_multiplier;
+        }
+        return (base + rules.hourly_rate * flight_minutes / 60.0) * cabin_multiplier * load_multiplier * advance_multiplier;
+    }
+
+public:
+    explicit FareEngine(const FareRules& rules = FareRules()) : rules(rules) {}
+
+    const FareRules& get_rules() const {
+        return rules;
+    }
+
+    void set_rules(const FareRules& new_rules) {
+        rules = new_rules;
+    }
+
+    // Reprice every row of a table for a cabin, bought at purchase_minutes (minutes since the epoch)
+    void reprice(FlightTable& table, CabinClass cabin, int32_t purchase_minutes) const {
+        const int32_t* departures = table.get_departure_column().data();
+        const int32_t* arrivals = table.get_arrival_column().data();
+        const FlightType* types = table.get_flight_type_column().data();
+        const double* load_factors = table.get_load_factor_column().data();
+        double* fares = table.get_fare_column().data();
+        const FareRules rules_copy = rules; // A local copy lets the compiler keep the rules in registers
+        double cabin_multiplier = rules_copy.cabin_multipliers[static_cast<size_t>(cabin)];
+        size_t rows = table.size();
+        for (size_t i = 0; i < rows; ++i) {
+            fares[i] = fare_for(rules_copy, static_cast<double>(types[i]), static_cast<double>(arrivals[i] - departures[i]),
+                                load_factors[i], static_cast<double>(departures[i] - purchase_minutes) / 1440.0, cabin_multiplier);
+        }
+    }
+
+    // Price a single flight leg with the same rules; the times come from the leg, the load from its flight
+    double quote(const ScheduleLeg& leg, CabinClass cabin, int32_t purchase_minutes) const {
+        const SeatMap& seats = leg.flight->get_seat_map();
+        return fare_for(rules, static_cast<double>(leg.flight_type),
+                        static_cast<double>(leg.arrival_minutes - leg.departure_minutes),
+                        static_cast<double>(seats.get_occupied_seats()) / seats.get_total_seats(),
+                        static_cast<double>(leg.departure_minutes - purchase_minutes) / 1440.0,
+                        rules.cabin_multipliers[static_cast<size_t>(cabin)]);
+    }
+};
+
+// Result of a journey search: the legs to fly, in order, and the final arrival time
+struct Journey {
+    vector<ScheduleLeg> legs;
+    int32_t arrival_minutes = INT32_MAX;
+
+    bool found() const { return arrival_minutes != INT32_MAX; }
+};
+
+// JourneyPlanner class answering route and multi-leg queries over a schedule
+class JourneyPlanner {
+private:
+    // One flight leg with its airports mapped to dense ids and its times parsed
+    struct Connection {
+        uint32_t from;
+        uint32_t to;
+        int32_t departure;
+        int32_t arrival;
+    };
+
+    // The legs the planner was built from; connections[i] describes legs[i]
+    vector<ScheduleLeg> legs;
+    // Airport names mapped to dense ids, so per-airport arrays stay small
+    unordered_map<string_view, uint32_t> airport_ids;
+    // All legs sorted by departure time, for the connection scan
+    vector<Connection> connections;
+    // CSR adjacency: departures of airport a are out_edges[out_offsets[a]] .. out_edges[out_offsets[a + 1] - 1]
+    vector<uint32_t> out_offsets;
+    vector<uint32_t> out_edges;
+
+    uint32_t dense_airport(string_view airport) {
+        return airport_ids.emplace(airport, static_cast<uint32_t>(airport_ids.size())).first->second;
+    }
+
+    bool find_airport(const string& name, uint32_t& id) const {
+        auto it = airport_ids.find(name);
+        if (it == airport_ids.end()) {
+            return false;
+        }
+        id = it->second;
+        return true;
+    }
+
+public:
+    // Most intermediate stops a journey may make; the scan keeps one arrival per airport for each
+    static constexpr int connection_limit = 8;
+
+    // Build the planner from legs in departure order, such as a range of a calendar version. The legs are
+    // copies, so the planner is unaffected by later changes to the calendar.
+    explicit JourneyPlanner(vector<ScheduleLeg> legs_by_departure) : legs(move(legs_by_departure)) {
+        // The legs are already in time order, so no sort is needed
+        connections.reserve(legs.size());
+        for (const auto& leg : legs) {
+            Connection connection;
+            connection.from = dense_airport(leg.origin);
+            connection.to = dense_airport(leg.destination);
+            connection.departure = leg.departure_minutes;
+            connection.arrival = leg.arrival_minutes;
+            connections.push_back(connection);
+        }
+
+        // Counting sort of legs by origin keeps each airport's departures in time order
+        out_offsets.assign(airport_ids.size() + 1, 0);
+        for (const auto& connection : connections) {
+            ++out_offsets[connection.from + 1];
+        }
+        for (size_t i = 1; i < out_offsets.size(); ++i) {
+            out_offsets[i] += out_offsets[i - 1];
+        }
+        out_edges.resize(connections.size());
+        vector<uint32_t> next(out_offsets.begin(), out_offsets.end() - 1);
+        for (uint32_t i = 0; i < connections.size(); ++i) {
+            out_edges[next[connections[i].from]++] = i;
+        }
+    }
+
+    // List the direct flights from origin to destination in departure order
+    vector<ScheduleLeg> flights_between(const string& origin, const string& destination) const {
+        vector<ScheduleLeg> result;
+        uint32_t from, to;
+        if (!find_airport(origin, from) || !find_airport(destination, to)) {
+            return result;
+        }
+        for (uint32_t e = out_offsets[from]; e < out_offsets[from + 1]; ++e) {
+            if (connections[out_edges[e]].to == to) {
+                result.push_back(legs[out_edges[e]]);
+            }
+        }
+        return result;
+    }
+
+    // Find the earliest arrival at destination leaving origin no earlier than depart_after,
+    // using at most max_connections intermediate stops of at least min_connection_minutes each.
+    // Finds no journey if max_connections is outside 0 .. connection_limit.
+    Journey earliest_arrival(const string& origin, const string& destination, int32_t depart_after,
+                             int max_connections, int min_connection_minutes) const {
+        Journey journey;
+        uint32_t from, to;
+        if (max_connections < 0 || max_connections > connection_limit || !find_airport(origin, from) || !find_airport(destination, to)) {
+            return journey;
+        }
+        if (from == to) {
+            journey.arrival_minutes = depart_after;
+            return journey;
+        }
+
+        // Connection Scan with one round per leg: arrival[k][a] is the earliest arrival at a using k legs
+        size_t airports = airport_ids.size();
+        // A journey cannot take more legs than there are
+        size_t rounds = min(static_cast<size_t>(max_connections) + 2, connections.size() + 1);
+        vector<int32_t> arrival(rounds * airports, INT32_MAX);
+        vector<uint32_t> via(rounds * airports, UINT32_MAX);
+        arrival[from] = depart_after;
+        int32_t best = INT32_MAX;
+
+        auto first = lower_bound(connections.begin(), connections.end(), depart_after, [](const Connection& c, int32_t t) {
+            return c.departure < t;
+        });
+        for (auto it = first; it != connections.end() && it->departure < best; ++it) {
+            const Connection& c = *it;
+            for (size_t k = 1; k < rounds; ++k) {
+                int32_t ready = arrival[(k - 1) * airports + c.from];
+                if (ready == INT32_MAX) {
+                    continue;
+                }
+                // The first leg leaves from the origin, later legs need time to connect
+                int64_t earliest_departure = static_cast<int64_t>(ready) + (k > 1 ? min_connection_minutes : 0);
+                if (c.departure < earliest_departure || c.arrival >= arrival[k * airports + c.to]) {
+                    continue;
+                }
+                arrival[k * airports + c.to] = c.arrival;
+                via[k * airports + c.to] = static_cast<uint32_t>(it - connections.begin());
+                if (c.to == to) {
+                    best = min(best, c.arrival);
+                }
+            }
+        }
+        if (best == INT32_MAX) {
+            return journey;
+        }
+
+        // Take the fewest legs that reach the best arrival and walk the legs back to the origin
+        size_t k = 1;
+        while (arrival[k * airports + to] != best) {
+            ++k;
+        }
+        journey.arrival_minutes = best;
+        for (uint32_t airport = to; k > 0; --k) {
+            uint32_t leg = via[k * airports + airport];
+            journey.legs.push_back(legs[leg]);
+            airport = connections[leg].from;
+        }
+        reverse(journey.legs.begin(), journey.legs.end());
+        return journey;
+    }
+};
+
+// Binary snapshot format. All integers are little-endian; records are fixed-size and refer to
+// strings and other records by offset or index, never by pointer, so a mapped file is usable as is.
+//
+//   SnapshotHeader | string bytes | FlightRecord[] | PassengerRecord[] | BookingRecord[]
+//                  | ItineraryRecord[] | uint32 booking indexes of all itineraries | RecurringFlightRecord[]
+//                  | int32 cancelled days of all recurring flights
+// Version 2 stores a calendar: every flight of the days in use, the recurring flights and the eviction horizon.
+// Version 3 adds the days a recurring flight no longer operates on, once those legs were cancelled or retimed.
+// Version 4 adds each flight's cancelled bookings that were removed, which its cancellation count still includes.
+const char snapshot_magic[8] = { 'F', 'L', 'T', 'S', 'N', 'A', 'P', '\0' };
+const uint32_t snapshot_version = 4;
+
+// Location of a string in the string section
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flight_count;
+    uint32_t passenger_count;
+    uint32_t booking_count;
+    uint32_t itinerary_count;
+    uint32_t itinerary_entry_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t flights_offset;
+    uint64_t passengers_offset;
+    uint64_t bookings_offset;
+    uint64_t itineraries_offset;
+    uint64_t itinerary_entries_offset;
+    uint64_t recurring_flights_offset;
+    uint32_t recurring_flight_count;
+    int32_t first_kept_day;
+    StringRef calendar_id;
+    uint64_t cancelled_days_offset;
+    uint32_t cancelled_day_count;
+};
+
+struct FlightRecord {
+    StringRef flight_number;
+    StringRef origin;
+    StringRef destination;
+    int32_t departure_minutes;
+    int32_t arrival_minutes;
+    uint32_t flight_type;
+    uint32_t removed_cancellations;
+};
+
+struct PassengerRecord {
+    StringRef name;
+    StringRef email;
+    StringRef phone_number;
+    StringRef passport_number;
+};
+
+struct BookingRecord {
+    StringRef booking_id;
+    StringRef seat_number;
+    uint32_t passenger_index; // Position in the passenger section
+    uint32_t flight_index;    // Position in the flight section
+    uint32_t booking_status;
+};
+
+struct ItineraryRecord {
+    StringRef itinerary_id;
+    uint32_t first_entry;     // Position in the itinerary entry section
+    uint32_t entry_count;
+};
+
+struct RecurringFlightRecord {
+    StringRef flight_number;
+    StringRef origin;
+    StringRef destination;
+    int32_t departure_minute_of_day;
+    int32_t duration_minutes;
+    int32_t first_day;
+    int32_t last_day;
+    uint32_t flight_type;
+    uint32_t weekdays;
+    uint32_t first_cancelled_day; // Position in the cancelled day section
+    uint32_t cancelled_day_count;
+};
+
+// Write the system state to a snapshot file; the file is replaced atomically
+void write_snapshot(const string& path, const ScheduleCalendar& calendar, const PassengerRegistry& passengers,
+                    const BookingStore& bookings, const vector<Itinerary*>& itineraries) {
+    // Repeated strings such as airport names are stored once
+    string strings;
+    unordered_map<string, StringRef> string_refs;
+    auto add_string = [&](const string& text) {
+        auto it = string_refs.find(text);
+        if (it != string_refs.end()) {
+            return it->second;
+        }
+        StringRef ref{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size()) };
+        strings += text;
+        string_refs.emplace(text, ref);
+        return ref;
+    };
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.calendar_id = add_string(calendar.get_calendar_id());
+    header.first_kept_day = calendar.get_first_kept_day();
+
+    vector<FlightRecord> flight_records;
+    unordered_map<const Flight*, uint32_t> flight_positions;
+    calendar.for_each_day([&](const Schedule& schedule) {
+        for (auto* flight : schedule.get_flights()) {
+            flight_positions.emplace(flight, static_cast<uint32_t>(flight_records.size()));
+            flight_records.push_back(FlightRecord{ add_string(flight->get_flight_number()), add_string(flight->get_origin()),
+                add_string(flight->get_destination()), flight->get_departure_minutes(), flight->get_arrival_minutes(),
+                static_cast<uint32_t>(flight->get_flight_type()), flight->get_removed_cancellations() });
+        }
+    });
+
+    vector<RecurringFlightRecord> recurring_records;
+    vector<int32_t> cancelled_days;
+    for (const auto& recurring : calendar.get_recurring_flights()) {
+        recurring_records.push_back(RecurringFlightRecord{ add_string(recurring.flight_number), add_string(recurring.origin),
+            add_string(recurring.destination), recurring.departure_minute_of_day, recurring.duration_minutes, recurring.first_day,
+            recurring.last_day, static_cast<uint32_t>(recurring.flight_type), recurring.weekdays,
+            static_cast<uint32_t>(cancelled_days.size()), static_cast<uint32_t>(recurring.cancelled_days.size()) });
+        cancelled_days.insert(cancelled_days.end(), recurring.cancelled_days.begin(), recurring.cancelled_days.end());
+    }
+
+    vector<PassengerRecord> passenger_records;
+    for (uint32_t i = 0; i < passengers.size(); ++i) {
+        const Passenger& passenger = passengers.get(PassengerHandle{ i });
+        passenger_records.push_back(PassengerRecord{ add_string(passenger.get_name()), add_string(passenger.get_email()),
+            add_string(passenger.get_phone_number()), add_string(passenger.get_passport_number()) });
+    }
+
+    vector<BookingRecord> booking_records;
+    unordered_map<const Booking*, uint32_t> booking_positions;
+    for (size_t i = 0; i < bookings.size(); ++i) {
+        const Booking* booking = bookings.at(i);
+        auto flight = flight_positions.find(booking->get_flight());
+        if (flight == flight_positions.end()) {
+            continue; // The flight has left the schedule, so the booking cannot be restored
+        }
+        booking_positions.emplace(booking, static_cast<uint32_t>(booking_records.size()));
+        booking_records.push_back(BookingRecord{ add_string(booking->get_booking_id()), add_string(booking->get_seat_number()),
+            booking->get_passenger_handle().index, flight->second, static_cast<uint32_t>(booking->get_booking_status()) });
+    }
+
+    vector<ItineraryRecord> itinerary_records;
+    vector<uint32_t> itinerary_entries;
+    for (auto* itinerary : itineraries) {
+        ItineraryRecord record{ add_string(itinerary->get_itinerary_id()), static_cast<uint32_t>(itinerary_entries.size()), 0 };
+        for (auto* booking : itinerary->get_bookings()) {
+            auto position = booking ? booking_positions.find(booking) : booking_positions.end();
+            if (position != booking_positions.end()) {
+                itinerary_entries.push_back(position->second);
+                ++record.entry_count;
+            }
+        }
+        itinerary_records.push_back(record);
+    }
+
+    // Lay the sections out back to back, each starting on an 8-byte boundary
+    string image(sizeof(SnapshotHeader), '\0');
+    auto append_section = [&image](const void* data, size_t size) {
+        image.resize((image.size() + 7) & ~size_t(7), '\0');
+        uint64_t offset = image.size();
+        image.append(static_cast<const char*>(data), size);
+        return offset;
+    };
+    header.strings_size = strings.size();
+    header.strings_offset = append_section(strings.data(), strings.size());
+    header.flight_count = static_cast<uint32_t>(flight_records.size());
+    header.flights_offset = append_section(flight_records.data(), flight_records.size() * sizeof(FlightRecord));
+    header.passenger_count = static_cast<uint32_t>(passenger_records.size());
+    header.passengers_offset = append_section(passenger_records.data(), passenger_records.size() * sizeof(PassengerRecord));
+    header.booking_count = static_cast<uint32_t>(booking_records.size());
+    header.bookings_offset = append_section(booking_records.data(), booking_records.size() * sizeof(BookingRecord));
+    header.itinerary_count = static_cast<uint32_t>(itinerary_records.size());
+    header.itineraries_offset = append_section(itinerary_records.data(), itinerary_records.size() * sizeof(ItineraryRecord));
+    header.itinerary_entry_count = static_cast<uint32_t>(itinerary_entries.size());
+    header.itinerary_entries_offset = append_section(itinerary_entries.data(), itinerary_entries.size() * sizeof(uint32_t));
+    header.recurring_flight_count = static_cast<uint32_t>(recurring_records.size());
+    header.recurring_flights_offset = append_section(recurring_records.data(), recurring_records.size() * sizeof(RecurringFlightRecord));
+    header.cancelled_day_count = static_cast<uint32_t>(cancelled_days.size());
+    header.cancelled_days_offset = append_section(cancelled_days.data(), cancelled_days.size() * sizeof(int32_t));
+    memcpy(&image[0], &header, sizeof(header));
+
+    // Write beside the target and rename over it, so readers never see a partial file
+    string temporary_path = path + ".tmp";
+    FILE* file = fopen(temporary_path.c_str(), "wb");
+    if (!file) {
+        throw SnapshotException();
+    }
+    bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+    written = fflush(file) == 0 && written;
+    written = fsync(fileno(file)) == 0 && written;
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary_path.c_str(), path.c_str()) != 0) {
+        remove(temporary_path.c_str());
+        throw SnapshotException();
+    }
+}
+
+// MappedFile class mapping a whole file read-only into memory
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (base) {
+            munmap(const_cast<char*>(base), length);
+        }
+    }
+
+    // Map a file, returning false if it cannot be opened or mapped; an empty file maps to no data
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        void* mapping = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        base = static_cast<const char*>(mapping);
+        return true;
+    }
+
+    const char* data() const {
+        return base;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// SnapshotView class mapping a snapshot file read-only and exposing its records in place
+class SnapshotView {
+private:
+    MappedFile file;
+    const char* base;
+    size_t length;
+
+    // Check that count records of a given size starting at offset lie inside the file
+    bool section_fits(uint64_t offset, uint64_t count, uint64_t record_size) const {
+        return offset % 4 == 0 && offset <= length && count * record_size <= length - offset;
+    }
+
+public:
+    // Map a snapshot file; throws SnapshotException if it cannot be read or fails validation
+    explicit SnapshotView(const string& path) {
+        if (!file.open(path) || file.size() < sizeof(SnapshotHeader)) {
+            throw SnapshotException();
+        }
+        base = file.data();
+        length = file.size();
+
+        const SnapshotHeader& h = header();
+        if (memcmp(h.magic, snapshot_magic, sizeof(h.magic)) != 0 || h.version != snapshot_version ||
+            !section_fits(h.strings_offset, h.strings_size, 1) ||
+            !section_fits(h.flights_offset, h.flight_count, sizeof(FlightRecord)) ||
+            !section_fits(h.passengers_offset, h.passenger_count, sizeof(PassengerRecord)) ||
+            !section_fits(h.bookings_offset, h.booking_count, sizeof(BookingRecord)) ||
+            !section_fits(h.itineraries_offset, h.itinerary_count, sizeof(ItineraryRecord)) ||
+            !section_fits(h.itinerary_entries_offset, h.itinerary_entry_count, sizeof(uint32_t)) ||
+            !section_fits(h.recurring_flights_offset, h.recurring_flight_count, sizeof(RecurringFlightRecord)) ||
+            !section_fits(h.cancelled_days_offset, h.cancelled_day_count, sizeof(int32_t))) {
+            throw SnapshotException();
+        }
+    }
+
+    const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(base);
+    }
+
+    // View a string in place; throws SnapshotException if the reference points outside the string section
+    string_view text(StringRef ref) const {
+        if (static_cast<uint64_t>(ref.offset) + ref.length > header().strings_size) {
+            throw SnapshotException();
+        }
+        return string_view(base + header().strings_offset + ref.offset, ref.length);
+    }
+
+    const FlightRecord* flights() const {
+        return reinterpret_cast<const FlightRecord*>(base + header().flights_offset);
+    }
+
+    const PassengerRecord* passengers() const {
+        return reinterpret_cast<const PassengerRecord*>(base + header().passengers_offset);
+    }
+
+    const BookingRecord* bookings() const {
+        return reinterpret_cast<const BookingRecord*>(base + header().bookings_offset);
+    }
+
+    const ItineraryRecord* itineraries() const {
+        return reinterpret_cast<const ItineraryRecord*>(base + header().itineraries_offset);
+    }
+
+    const uint32_t* itinerary_entries() const {
+        return reinterpret_cast<const uint32_t*>(base + header().itinerary_entries_offset);
+    }
+
+    const RecurringFlightRecord* recurring_flights() const {
+        return reinterpret_cast<const RecurringFlightRecord*>(base + header().recurring_flights_offset);
+    }
+
+    const int32_t* cancelled_days() const {
+        return reinterpret_cast<const int32_t*>(base + header().cancelled_days_offset);
+    }
+};
+
+// Rebuild the system state from a mapped snapshot and return the new calendar. Passenger handles are registry
+// positions, so the registry and the booking store must be empty; the itineraries are appended to the vector.
+// Throws SnapshotException if the stores are not empty or the snapshot refers to records that do not exist or
+// cannot be restored; a failed load leaves the stores empty and the vector as it was.
+ScheduleCalendar* load_snapshot(const SnapshotView& snapshot, PassengerRegistry& passengers, BookingStore& bookings,
+                                vector<Itinerary*>& itineraries) {
+    if (passengers.size() || bookings.size()) {
+        throw SnapshotException();
+    }
+    const SnapshotHeader& header = snapshot.header();
+    size_t first_itinerary = itineraries.size();
+    unique_ptr<ScheduleCalendar> calendar(new ScheduleCalendar(string(snapshot.text(header.calendar_id))));
+    vector<Flight*> flights;
+    vector<Booking*> loaded_bookings;
+    try {
+        calendar->restore_first_kept_day(header.first_kept_day);
+        // Checked up front, so the flights go to the calendar in one batch and are published once
+        for (uint32_t i = 0; i < header.flight_count; ++i) {
+            const FlightRecord& record = snapshot.flights()[i];
+            if (record.flight_type > static_cast<uint32_t>(FlightType::International) || record.arrival_minutes < record.departure_minutes ||
+                day_of(record.departure_minutes) < header.first_kept_day) {
+                throw SnapshotException();
+            }
+        }
+        flights.reserve(header.flight_count);
+        for (uint32_t i = 0; i < header.flight_count; ++i) {
+            const FlightRecord& record = snapshot.flights()[i];
+            flights.push_back(FlightFactory::create_flight(static_cast<FlightType>(record.flight_type), snapshot.text(record.flight_number),
+                snapshot.text(record.origin), snapshot.text(record.destination), record.departure_minutes, record.arrival_minutes));
+        }
+        calendar->add_flights(flights);
+        for (uint32_t i = 0; i < header.flight_count; ++i) {
+            uint32_t removed = snapshot.flights()[i].removed_cancellations;
+            if (removed > INT32_MAX) {
+                throw SnapshotException();
+            }
+            flights[i]->count_removed_cancellations(removed);
+            BookingLedger::instance().count(*flights[i], BookingStatus::Cancelled, static_cast<int>(removed));
+        }
+
+        // Added after the saved flights, so days in use keep their saved legs instead of new copies
+        for (uint32_t i = 0; i < header.recurring_flight_count; ++i) {
+            const RecurringFlightRecord& record = snapshot.recurring_flights()[i];
+            if (record.flight_type > static_cast<uint32_t>(FlightType::International) || record.weekdays > every_day ||
+                record.departure_minute_of_day < 0 || record.departure_minute_of_day >= 1440 || record.duration_minutes < 0 ||
+                record.first_cancelled_day > header.cancelled_day_count || record.cancelled_day_count > header.cancelled_day_count - record.first_cancelled_day) {
+                throw SnapshotException();
+            }
+            const int32_t* cancelled = snapshot.cancelled_days() + record.first_cancelled_day;
+            vector<int32_t> cancelled_days(cancelled, cancelled + record.cancelled_day_count);
+            if (!is_sorted(cancelled_days.begin(), cancelled_days.end())) {
+                throw SnapshotException();
+            }
+            calendar->add_recurring_flight(RecurringFlight{ static_cast<FlightType>(record.flight_type), string(snapshot.text(record.flight_number)),
+                string(snapshot.text(record.origin)), string(snapshot.text(record.destination)), record.departure_minute_of_day,
+                record.duration_minutes, static_cast<uint8_t>(record.weekdays), record.first_day, record.last_day, move(cancelled_days) });
+        }
+
+        // Passenger handles are registry positions, so they match the record order
+        for (uint32_t i = 0; i < header.passenger_count; ++i) {
+            const PassengerRecord& record = snapshot.passengers()[i];
+            PassengerHandle handle = passengers.add_passenger(string(snapshot.text(record.name)), string(snapshot.text(record.email)),
+                string(snapshot.text(record.phone_number)), string(snapshot.text(record.passport_number)));
+            if (handle.index != i) {
+                throw SnapshotException();
+            }
+        }
+
+        loaded_bookings.reserve(header.booking_count);
+        for (uint32_t i = 0; i < header.booking_count; ++i) {
+            const BookingRecord& record = snapshot.bookings()[i];
+            if (record.flight_index >= flights.size() || record.passenger_index >= passengers.size() ||
+                record.booking_status > static_cast<uint32_t>(BookingStatus::Cancelled)) {
+                throw SnapshotException();
+            }
+            Flight* flight = flights[record.flight_index];
+            PassengerHandle passenger{ record.passenger_index };
+            Booking* booking = bookings.get(bookings.create_booking(string(snapshot.text(record.booking_id)), passengers, passenger, flight,
+                string(snapshot.text(record.seat_number)), static_cast<BookingStatus>(record.booking_status)));
+            if (!booking) {
+                throw SnapshotException();
+            }
+            flight->attach(&passengers.get(passenger));
+            loaded_bookings.push_back(booking);
+        }
+
+        for (uint32_t i = 0; i < header.itinerary_count; ++i) {
+            const ItineraryRecord& record = snapshot.itineraries()[i];
+            if (record.first_entry > header.itinerary_entry_count || record.entry_count > header.itinerary_entry_count - record.first_entry) {
+                throw SnapshotException();
+            }
+            itineraries.push_back(new Itinerary(string(snapshot.text(record.itinerary_id))));
+            for (uint32_t e = 0; e < record.entry_count; ++e) {
+                uint32_t booking_index = snapshot.itinerary_entries()[record.first_entry + e];
+                if (booking_index >= loaded_bookings.size()) {
+                    throw SnapshotException();
+                }
+                itineraries.back()->add_booking(loaded_bookings[booking_index]);
+            }
+        }
+    } catch (...) {
+        // Bad references, invalid times or conflicting seats: undo the partial load
+        for (size_t i = first_itinerary; i < itineraries.size(); ++i) {
+            delete itineraries[i];
+        }
+        itineraries.resize(first_itinerary);
+        // The stores were empty, so everything in them came from this load. The calendar destroys its flights
+        // once the bookings on them are gone.
+        bookings.clear();
+        passengers.clear();
+        throw SnapshotException();
+    }
+    return calendar.release();
+}
+
+// Outcome of replaying the booking journal
+struct JournalReplayResult {
+    size_t records_applied = 0;
+    size_t records_skipped = 0; // Records referring to flights, passengers or bookings that do not exist
+    size_t valid_size = 0;      // Bytes up to the end of the last intact record
+    bool torn_tail = false;     // Bytes after valid_size were an incomplete or corrupt record
+};
+
+// Reapply the journal on top of the state it was recorded against: the snapshot it pairs with, or the
+// sample data. Call before the journal is opened so replayed changes are not journaled again. A missing
+// journal replays as empty; records that no longer apply, such as bookings on unscheduled flights, are skipped.
+JournalReplayResult replay_journal(const string& path, ScheduleCalendar& calendar, PassengerRegistry& passengers, BookingStore& bookings,
+                                   vector<Itinerary*>& itineraries) {
+    JournalReplayResult result;
+    MappedFile file;
+    if (!file.open(path)) {
+        return result;
+    }
+    auto find_itinerary = [&itineraries](string_view itinerary_id) -> Itinerary* {
+        for (auto* itinerary : itineraries) {
+            if (itinerary->get_itinerary_id() == itinerary_id) {
+                return itinerary;
+            }
+        }
+        return nullptr;
+    };
+    auto apply = [&](const JournalRecord& record) {
+        const string_view* fields = record.fields;
+        if (record.status > BookingStatus::Cancelled) {
+            return false;
+        }
+        switch (record.type) {
+        case JournalRecordType::PassengerAdded:
+            return record.field_count == 4 &&
+                   passengers.add_passenger(string(fields[0]), string(fields[1]), string(fields[2]), string(fields[3])).is_valid();
+        case JournalRecordType::BookingCreated:
+            {
+                PassengerHandle passenger = passengers.find(fields[1]);
+                int32_t day;
+                Flight* flight = record.field_count == 5 && parse_date(fields[3], day) ? calendar.find_flight(fields[2], day) : nullptr;
+                if (!passenger.is_valid() || !flight) {
+                    return false;
+                }
+                try {
+                    if (!bookings.create_booking(string(fields[0]), passengers, passenger, flight, string(fields[4]), record.status).is_valid()) {
+                        return false;
+                    }
+                } catch (const SeatUnavailableException&) {
+                    return false;
+                }
+                flight->attach(&passengers.get(passenger));
+                return true;
+            }
+        case JournalRecordType::BookingStatusChanged:
+        case JournalRecordType::BookingCancelled:
+        case JournalRecordType::BookingRemoved:
+            {
+                BookingHandle handle = record.field_count == 1 ? bookings.find(fields[0]) : BookingHandle();
+                Booking* booking = bookings.get(handle);
+                if (!booking) {
+                    return false;
+                }
+                if (record.type == JournalRecordType::BookingStatusChanged) {
+                    if (!booking_status_can_change(booking->get_booking_status(), record.status)) {
+                        return false;
+                    }
+                    booking->restore_status(record.status);
+                } else if (record.type == JournalRecordType::BookingCancelled) {
+                    if (!booking_status_can_change(booking->get_booking_status(), BookingStatus::Cancelled)) {
+                        return false;
+                    }
+                    booking->restore_cancelled();
+                } else {
+                    booking->get_flight()->detach(booking->get_passenger());
+                    bookings.remove(handle);
+                }
+                return true;
+            }
+        case JournalRecordType::ItineraryBookingAdded:
+        case JournalRecordType::ItineraryBookingRemoved:
+            {
+                Booking* booking = record.field_count == 2 ? bookings.get(bookings.find(fields[1])) : nullptr;
+                if (!booking) {
+                    return false;
+                }
+                Itinerary* itinerary = find_itinerary(fields[0]);
+                if (record.type == JournalRecordType::ItineraryBookingRemoved) {
+                    if (itinerary) {
+                        itinerary->remove_booking(booking);
+                    }
+                    return itinerary != nullptr;
+                }
+                if (!itinerary) {
+                    itineraries.push_back(itinerary = new Itinerary(string(fields[0])));
+                }
+                itinerary->add_booking(booking);
+                return true;
+            }
+        case JournalRecordType::DaysEvicted:
+            {
+                int32_t first_day;
+                if (record.field_count != 1 || !parse_date(fields[0], first_day)) {
+                    return false;
+                }
+                calendar.evict_before(first_day, bookings);
+                return true;
+            }
+        case JournalRecordType::FlightRetimed:
+            {
+                int32_t day, departure, arrival;
+                if (record.field_count != 4 || !parse_date(fields[1], day) || !parse_timestamp(fields[2], departure) ||
+                    !parse_timestamp(fields[3], arrival) || arrival < departure) {
+                    return false;
+                }
+                return calendar.retime_flight(fields[0], day, departure, arrival) != nullptr;
+            }
+        case JournalRecordType::FlightCancelled:
+            {
+                int32_t day;
+                return record.field_count == 2 && parse_date(fields[1], day) && calendar.cancel_flight(fields[0], day, bookings);
+            }
+        case JournalRecordType::FlightAdded:
+            {
+                FlightType flight_type;
+                int32_t departure, arrival;
+                if (record.field_count != 6 || !parse_flight_type(fields[0], flight_type) || !parse_timestamp(fields[4], departure) ||
+                    !parse_timestamp(fields[5], arrival) || arrival < departure) {
+                    return false;
+                }
+                int32_t day = day_of(departure);
+                if (calendar.is_evicted(day) || calendar.find_flight(fields[1], day)) {
+                    return false;
+                }
+                calendar.add_flights({ FlightFactory::create_flight(flight_type, fields[1], fields[2], fields[3], departure, arrival) });
+                return true;
+            }
+        }
+        return false;
+    };
+
+    string_view data(file.data(), file.size());
+    JournalRecord record;
+    while (BookingJournal::read_record(data, record)) {
+        if (apply(record)) {
+            ++result.records_applied;
+        } else {
+            ++result.records_skipped;
+        }
+    }
+    result.valid_size = file.size() - data.size();
+    result.torn_tail = !data.empty();
+    return result;
+}
+
+// Bulk CSV import. A feed is mapped whole, cut into one chunk per thread at line boundaries and
+// parsed in parallel into views of the mapped bytes; the parsed rows are then added in file order
+// on the calling thread, since symbol interning and the containers are not thread-safe.
+// Fields are separated by commas and may not be quoted; blank lines are skipped and CRLF is accepted.
+//   flights:    type,flight_number,origin,destination,departure_time,arrival_time
+//   passengers: name,email,phone_number,passport_number
+
+// Outcome of an import: rows added, rows rejected as malformed or duplicate, and throughput
+struct ImportResult {
+    size_t rows_loaded = 0;
+    size_t rows_rejected = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+};
+
+// Split a line into exactly field_count comma-separated, non-empty fields
+bool split_csv_line(string_view line, string_view* fields, size_t field_count) {
+    size_t count = 0;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        string_view field = line.substr(start, comma == string_view::npos ? string_view::npos : comma - start);
+        if (count == field_count || field.empty()) {
+            return false;
+        }
+        fields[count++] = field;
+        if (comma == string_view::npos) {
+            return count == field_count;
+        }
+        start = comma + 1;
+    }
+}
+
+// Parse the lines of data in parallel. parse_row(line, row) returns false to reject a line; the rows and
+// rejections of each chunk are kept apart so the caller can consume them in file order.
+template <typename Row, typename ParseRow>
+void parse_csv_chunks(string_view data, ParseRow parse_row, vector<vector<Row>>& rows, vector<size_t>& rejected) {
+    // Below about a megabyte per thread, starting threads costs more than it saves
+    const size_t min_chunk_bytes = 1 << 20;
+    size_t chunk_count = max<size_t>(1, min<size_t>(max(1u, thread::hardware_concurrency()), data.size() / min_chunk_bytes));
+    vector<size_t> bounds(chunk_count + 1, data.size());
+    bounds[0] = 0;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        size_t newline = data.find('\n', max(bounds[i - 1], data.size() / chunk_count * i));
+        bounds[i] = newline == string_view::npos ? data.size() : newline + 1;
+    }
+    rows.assign(chunk_count, vector<Row>());
+    rejected.assign(chunk_count, 0);
+
+    auto parse_chunk = [&](size_t chunk) {
+        string_view text = data.substr(bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            string_view line = text.substr(0, newline);
+            text.remove_prefix(newline == string_view::npos ? text.size() : newline + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+            Row row;
+            if (parse_row(line, row)) {
+                rows[chunk].push_back(row);
+            } else {
+                ++rejected[chunk];
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+        workers.emplace_back(parse_chunk, chunk);
+    }
+    parse_chunk(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Drop a header line starting with the given column name
+string_view skip_csv_header(string_view data, string_view first_column) {
+    if (data.substr(0, first_column.size() + 1) == string(first_column) + ",") {
+        size_t newline = data.find('\n');
+        data.remove_prefix(newline == string_view::npos ? data.size() : newline + 1);
+    }
+    return data;
+}
+
+// Flight row as parsed from a feed; the views point into the mapped file
+struct FlightCsvRow {
+    FlightType flight_type;
+    string_view flight_number;
+    string_view origin;
+    string_view destination;
+    int32_t departure_minutes;
+    int32_t arrival_minutes;
+};
+
+// Import a flight feed into a calendar, rejecting malformed rows, flight numbers already scheduled on the
+// same day and flights departing on evicted days. Added flights are journaled, so a replay restores them.
+// Returns false if the file cannot be read.
+bool import_flights_csv(const string& path, ScheduleCalendar& calendar, ImportResult& result) {
+    auto started = chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    result = ImportResult();
+    result.bytes = file.size();
+    string_view data = skip_csv_header(string_view(file.data(), file.size()), "type");
+
+    vector<vector<FlightCsvRow>> rows;
+    vector<size_t> rejected;
+    parse_csv_chunks<FlightCsvRow>(data, [](string_view line, FlightCsvRow& row) {
+        string_view fields[6];
+        if (!split_csv_line(line, fields, 6)) {
+            return false;
+        }
+        if (!parse_flight_type(fields[0], row.flight_type)) {
+            return false;
+        }
+        row.flight_number = fields[1];
+        row.origin = fields[2];
+        row.destination = fields[3];
+        return parse_timestamp(fields[4], row.departure_minutes) && parse_timestamp(fields[5], row.arrival_minutes) &&
+               row.departure_minutes <= row.arrival_minutes;
+    }, rows, rejected);
+
+    vector<Flight*> new_flights;
+    set<pair<string_view, int32_t>> new_numbers; // Flight number and departure day of each accepted row
+    for (size_t chunk = 0; chunk < rows.size(); ++chunk) {
+        result.rows_rejected += rejected[chunk];
+        for (const auto& row : rows[chunk]) {
+            int32_t day = day_of(row.departure_minutes);
+            if (calendar.is_evicted(day) || calendar.find_flight(row.flight_number, day) || !new_numbers.emplace(row.flight_number, day).second) {
+                ++result.rows_rejected;
+                continue;
+            }
+            Flight* flight = FlightFactory::create_flight(row.flight_type, row.flight_number, row.origin, row.destination,
+                                                          row.departure_minutes, row.arrival_minutes);
+            new_flights.push_back(flight);
+            BookingJournal::instance().append(JournalRecordType::FlightAdded, BookingStatus::Pending,
+                { flight_type_name(row.flight_type), row.flight_number, row.origin, row.destination,
+                  format_timestamp(row.departure_minutes), format_timestamp(row.arrival_minutes) });
+        }
+    }
+    calendar.add_flights(new_flights);
+    BookingJournal::instance().sync();
+    result.rows_loaded = new_flights.size();
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+// Passenger row as parsed from a feed; the views point into the mapped file
+struct PassengerCsvRow {
+    string_view name;
+    string_view email;
+    string_view phone_number;
+    string_view passport_number;
+};
+
+// Import a passenger feed into the registry, rejecting malformed rows and passport numbers already registered.
+// Returns false if the file cannot be read.
+bool import_passengers_csv(const string& path, PassengerRegistry& registry, ImportResult& result) {
+    auto started = chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    result = ImportResult();
+    result.bytes = file.size();
+    string_view data = skip_csv_header(string_view(file.data(), file.size()), "name");
+
+    vector<vector<PassengerCsvRow>> rows;
+    vector<size_t> rejected;
+    parse_csv_chunks<PassengerCsvRow>(data, [](string_view line, PassengerCsvRow& row) {
+        string_view fields[4];
+        if (!split_csv_line(line, fields, 4)) {
+            return false;
+        }
+        row = PassengerCsvRow{ fields[0], fields[1], fields[2], fields[3] };
+        return true;
+    }, rows, rejected);
+
+    for (size_t chunk = 0; chunk < rows.size(); ++chunk) {
+        result.rows_rejected += rejected[chunk];
+        for (const auto& row : rows[chunk]) {
+            PassengerHandle handle = registry.add_passenger(string(row.name), string(row.email), string(row.phone_number),
+                                                            string(row.passport_number));
+            if (handle.is_valid()) {
+                ++result.rows_loaded;
+            } else {
+                ++result.rows_rejected;
+            }
+        }
+    }
+    BookingJournal::instance().sync();
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+// Function to append the passengers on a given flight to a report
+void append_passengers(const Flight* flight, string& out) {
+    out += "Passengers on flight ";
+    out += flight->get_flight_number();
+    out += ":\n";
+    for (const ManifestLink* link = flight->manifest_begin(); link != flight->manifest_end(); link = link->next) {
+        Passenger* passenger = static_cast<const Booking*>(link)->get_passenger();
+        if (passenger) {
+            passenger->append_passenger_info(out);
+        }
+    }
+}
+
+// Function to append a flight's manifest, one line per booking in booking order, to a report
+void append_manifest(const Flight* flight, string& out) {
+    out += "Manifest for flight ";
+    out += flight->get_flight_number();
+    out += ", ";
+    out += flight->get_origin();
+    out += " to ";
+    out += flight->get_destination();
+    out += ", departing ";
+    out += format_timestamp(flight->get_departure_minutes());
+    out += ": ";
+    out += to_string(flight->get_booking_count());
+    out += " bookings\n";
+    for (const ManifestLink* link = flight->manifest_begin(); link != flight->manifest_end(); link = link->next) {
+        const Booking* booking = static_cast<const Booking*>(link);
+        const Passenger* passenger = booking->get_passenger();
+        out += "  Seat ";
+        out += booking->get_seat_number();
+        out += ", Booking ID: ";
+        out += booking->get_booking_id();
+        out += ", Status: ";
+        out += booking_status_name(booking->get_booking_status());
+        out += ", Passenger: ";
+        out += passenger->get_name();
+        out += ", Passport Number: ";
+        out += passenger->get_passport_number();
+        out += '\n';
+    }
+}
+
+// Function to display all passengers on domestic and international flights separately
+void display_passengers_by_flight_type(const ScheduleCalendar& calendar) {
+    vector<const Flight*> flights;
+    auto collect = [&flights](const Flight* flight) { flights.push_back(flight); };
+    auto render = [&flights](size_t i, string& out) { append_passengers(flights[i], out); };
+
+    cout << "Passengers on Domestic Flights:" << '\n';
+    calendar.for_each_flight_of_kind<FlightType::Domestic>(collect);
+    write_report(flights.size(), render);
+
+    flights.clear();
+    cout << "Passengers on International Flights:" << '\n';
+    calendar.for_each_flight_of_kind<FlightType::International>(collect);
+    write_report(flights.size(), render);
+}
+
+// Function to print the manifest of every flight departing on a date, rendered in parallel
+void print_manifests(ScheduleCalendar& calendar) {
+    string date;
+    int32_t day;
+    cout << "Enter date (YYYY-MM-DD): ";
+    cin >> date;
+    if (!parse_date(date, day)) {
+        cout << "Invalid date" << endl;
+        return;
+    }
+    vector<Flight*> flights = calendar.flights_departing_between(day * 1440, (day + 1) * 1440);
+    if (flights.empty()) {
+        cout << "No flights depart on " << date << endl;
+        return;
+    }
+    write_report(flights.size(), [&flights](size_t i, string& out) { append_manifest(flights[i], out); });
+}
+
+// Function to print a day's booking totals, with each of its flights and their routes, from the ledger
+void print_booking_totals(ScheduleCalendar& calendar) {
+    string date;
+    int32_t day;
+    cout << "Enter date (YYYY-MM-DD): ";
+    cin >> date;
+    if (!parse_date(date, day)) {
+        cout << "Invalid date" << endl;
+        return;
+    }
+    const BookingLedger& ledger = BookingLedger::instance();
+    string out = "Bookings departing " + date + ": ";
+    ledger.get_day_totals(day).append_totals(out);
+    vector<Flight*> flights = calendar.flights_departing_between(day * 1440, (day + 1) * 1440);
+    set<pair<Symbol, Symbol>> routes;
+    for (auto* flight : flights) {
+        out += "  " + flight->get_flight_number() + ": ";
+        flight->get_booking_totals().append_totals(out);
+        routes.emplace(flight->get_origin_id(), flight->get_destination_id());
+    }
+    for (const auto& route : routes) {
+        const SymbolTable& symbols = SymbolTable::instance();
+        out += "  Route " + symbols.name(route.first) + " to " + symbols.name(route.second) + ", all days: ";
+        ledger.get_route_totals(route.first, route.second).append_totals(out);
+    }
+    cout << out;
+}
+
+// Recompute every booking total by scanning all bookings and compare with the ledger's and the flights'.
+// Cancelled bookings that were removed are counted from each flight's removed count, and the route and day
+// roll-ups are summed from the scan, so every total is checked against the bookings themselves.
+// Returns the number of totals that differ, so 0 means the incremental totals are consistent.
+size_t verify_booking_totals(const ScheduleCalendar& calendar, const BookingStore& bookings) {
+    unordered_map<const Flight*, BookingTotals> by_flight;
+    for (size_t i = 0; i < bookings.size(); ++i) {
+        const Booking* booking = bookings.at(i);
+        const Flight* flight = booking->get_flight();
+        by_flight[flight].count(booking->get_booking_status(), flight->get_base_fare(), 1);
+    }
+
+    size_t mismatches = 0;
+    size_t flights_scanned = 0;
+    map<pair<Symbol, Symbol>, BookingTotals> by_route;
+    map<int32_t, BookingTotals> by_day;
+    calendar.for_each_day([&](const Schedule& schedule) {
+        for (const auto* flight : schedule.get_flights()) {
+            const BookingTotals& totals = flight->get_booking_totals();
+            BookingTotals scanned;
+            auto it = by_flight.find(flight);
+            if (it != by_flight.end()) {
+                scanned = it->second;
+                ++flights_scanned;
+            }
+            scanned.count(BookingStatus::Cancelled, 0.0, static_cast<int>(flight->get_removed_cancellations()));
+            mismatches += !totals.matches(scanned);
+            if (!scanned.empty()) {
+                by_route[{ flight->get_origin_id(), flight->get_destination_id() }].add(scanned, 1);
+                by_day[day_of(flight->get_departure_minutes())].add(scanned, 1);
+            }
+        }
+    });
+    // Bookings on flights the calendar no longer holds
+    mismatches += by_flight.size() - flights_scanned;
+    const BookingLedger& ledger = BookingLedger::instance();
+    for (const auto& entry : by_route) {
+        mismatches += !ledger.get_route_totals(entry.first.first, entry.first.second).matches(entry.second);
+    }
+    ledger.for_each_route([&](Symbol origin, Symbol destination, const BookingTotals&) {
+        mismatches += !by_route.count({ origin, destination });
+    });
+    for (const auto& entry : by_day) {
+        mismatches += !ledger.get_day_totals(entry.first).matches(entry.second);
+    }
+    for (const auto& entry : ledger.get_days()) {
+        mismatches += !by_day.count(entry.first);
+    }
+    return mismatches;
+}
+
+// Function to modify passenger information
+void modify_passenger_info(Passenger* passenger) {
+    int choice;
+    cout << "Modify Passenger Information for " << passenger->get_name() << endl;
+    cout << "1. Email" << endl;
+    cout << "2. Phone Number" << endl;
+    cout << "Enter your choice: ";
+    cin >> choice;
+
+    string new_info;
+    switch (choice) {
+    case 1:
+        cout << "Enter new email: ";
+        cin >> new_info;
+        passenger->set_email(new_info);
+        break;
+    case 2:
+        cout << "Enter new phone number: ";
+        cin >> new_info;
+        passenger->set_phone_number(new_info);
+        break;
+    default:
+        cout << "Invalid choice" << endl;
+    }
+}
+
+// Function to add a new passenger
+PassengerHandle add_passenger(PassengerRegistry& registry) {
+    string name, email, phone_number, passport_number;
+    cout << "Enter passenger details:" << endl;
+    cout << "Name: ";
+    cin >> ws;
+    getline(cin, name);
+    cout << "Email: ";
+    getline(cin, email);
+    cout << "Phone Number: ";
+    getline(cin, phone_number);
+    cout << "Passport Number: ";
+    getline(cin, passport_number);
+    PassengerHandle handle = registry.add_passenger(name, email, phone_number, passport_number);
+    BookingJournal::instance().sync();
+    return handle;
+}
+
+// Function to book a new flight for a passenger
+BookingHandle book_flight(BookingStore& bookings, PassengerRegistry& registry, PassengerHandle passenger, ScheduleCalendar& calendar) {
+    string flight_number, departure_date, seat_number, booking_id;
+    int32_t departure_day;
+    cout << "Enter flight number: ";
+    cin >> flight_number;
+    cout << "Enter departure date (YYYY-MM-DD): ";
+    cin >> departure_date;
+    if (!parse_date(departure_date, departure_day)) {
+        cout << "Invalid date" << endl;
+        return BookingHandle();
+    }
+    try {
+        Flight* flight = find_flight_by_number(calendar, flight_number, departure_day);
+        if (!flight->check_availability()) {
+            cout << "Flight is full" << endl;
+            return BookingHandle();
+        }
+        cout << "Enter seat number (or 'any' for the next free seat): ";
+        cin >> seat_number;
+        if (seat_number == "any") {
+            seat_number = flight->get_seat_map().seat_label(flight->get_seat_map().next_free_seat());
+            cout << "Assigned seat " << seat_number << endl;
+        }
+        cout << "Enter booking ID: ";
+        cin >> booking_id;
+        BookingHandle new_booking = bookings.create_booking(booking_id, registry, passenger, flight, seat_number, BookingStatus::Pending);
+        if (!new_booking.is_valid()) {
+            cout << "Booking ID already exists" << endl;
+            return new_booking;
+        }
+        flight->attach(&registry.get(passenger));
+        return new_booking;
+    } catch (const FlightNotFoundException& e) {
+        cout << e.what() << endl;
+        return BookingHandle();
+    } catch (const SeatUnavailableException& e) {
+        cout << e.what() << endl;
+        return BookingHandle();
+    }
+}
+
+// Function to cancel a booking and remove it from its itinerary and the store; false if there is no such booking
+bool cancel_booking(BookingStore& bookings, string_view booking_id) {
+    INSTRUMENT_SCOPE(Probe::CancelBooking);
+    BookingHandle handle = bookings.find(booking_id);
+    Booking* booking = bookings.get(handle);
+    if (!booking) {
+        return false;
+    }
+    if (booking->get_booking_status() != BookingStatus::Cancelled) {
+        booking->cancel_booking();
+    }
+    booking->get_flight()->detach(booking->get_passenger());
+    bookings.remove(handle);
+    return true;
+}
+
+// Function to view a specific passenger's details
+void view_passenger_details(const PassengerRegistry& registry) {
+    string passport_number;
+    cout << "Enter passport number: ";
+    cin >> passport_number;
+    PassengerHandle passenger = registry.find(passport_number);
+    if (passenger.is_valid()) {
+        registry.get(passenger).get_passenger_info();
+        return;
+    }
+    cout << "Passenger not found" << endl;
+}
+
+// Function to plan a journey between two airports, among flights departing within journey_window_minutes
+const int32_t journey_window_minutes = 3 * 1440;
+
+int32_t journey_window_end(int32_t depart_after) {
+    return depart_after > INT32_MAX - journey_window_minutes ? INT32_MAX : depart_after + journey_window_minutes;
+}
+
+// Plan over a calendar version whose window has been expanded and append the journey; false if none was found
+bool append_journey(const CalendarSnapshot& snapshot, const string& origin, const string& destination, int32_t depart_after,
+                    int max_connections, int min_connection_minutes, string& out) {
+    JourneyPlanner planner(snapshot.legs_departing_between(depart_after, journey_window_end(depart_after)));
+    Journey journey = planner.earliest_arrival(origin, destination, depart_after, max_connections, min_connection_minutes);
+    if (!journey.found()) {
+        return false;
+    }
+    out += "Journey arriving ";
+    out += format_timestamp(journey.arrival_minutes);
+    out += ":\n";
+    for (const auto& leg : journey.legs) {
+        leg.append_leg_info(out);
+    }
+    return true;
+}
+
+void plan_journey(ScheduleCalendar& calendar) {
+    string origin, destination, departure_time;
+    int max_connections, min_connection_minutes;
+    int32_t depart_after;
+    cout << "Origin: ";
+    cin >> ws;
+    getline(cin, origin);
+    cout << "Destination: ";
+    getline(cin, destination);
+    cout << "Earliest departure (YYYY-MM-DD HH:MM): ";
+    getline(cin, departure_time);
+    if (!parse_timestamp(departure_time, depart_after)) {
+        cout << "Invalid departure time" << endl;
+        return;
+    }
+    cout << "Maximum connections: ";
+    cin >> max_connections;
+    if (!cin || max_connections < 0 || max_connections > JourneyPlanner::connection_limit) {
+        cout << "Maximum connections must be between 0 and " << JourneyPlanner::connection_limit << endl;
+        return;
+    }
+    cout << "Minimum connection time (minutes): ";
+    cin >> min_connection_minutes;
+
+    calendar.expand_range(depart_after, journey_window_end(depart_after));
+    EpochGuard guard;
+    string out;
+    if (!append_journey(calendar.get_snapshot(), origin, destination, depart_after, max_connections, min_connection_minutes, out)) {
+        cout << "No journey found" << endl;
+        return;
+    }
+    cout << out;
+}
+
+// Function to list flights departing within a time window
+void view_flights_departing_between(ScheduleCalendar& calendar) {
+    string from_time, to_time;
+    int32_t from_minutes, to_minutes;
+    cout << "From (YYYY-MM-DD HH:MM): ";
+    cin >> ws;
+    getline(cin, from_time);
+    cout << "To (YYYY-MM-DD HH:MM): ";
+    getline(cin, to_time);
+    if (!parse_timestamp(from_time, from_minutes) || !parse_timestamp(to_time, to_minutes)) {
+        cout << "Invalid time" << endl;
+        return;
+    }
+    vector<Flight*> flights = calendar.flights_departing_between(from_minutes, to_minutes);
+    if (flights.empty()) {
+        cout << "No flights depart in that window" << endl;
+        return;
+    }
+    for (auto* flight : flights) {
+        flight->get_flight_info();
+    }
+}
+
+// Function to append a flight leg's fares as of now under the default rules, for each cabin the flight has
+void append_fare_quotes(const ScheduleLeg& leg, string& out) {
+    FareEngine fare_engine;
+    int32_t now_minutes = static_cast<int32_t>(time(nullptr) / 60);
+    for (const auto& cabin : leg.flight->get_seat_map().get_cabins()) {
+        CabinClass cabin_class = cabin.name == "Business" ? CabinClass::Business : CabinClass::Economy;
+        char fare[32];
+        snprintf(fare, sizeof(fare), "%g", fare_engine.quote(leg, cabin_class, now_minutes));
+        out += cabin.name;
+        out += " fare: ";
+        out += fare;
+        out += '\n';
+    }
+}
+
+// Function to view flight details
+void view_flight_details(ScheduleCalendar& calendar) {
+    string flight_number, departure_date;
+    int32_t departure_day;
+    cout << "Enter flight number: ";
+    cin >> flight_number;
+    cout << "Enter departure date (YYYY-MM-DD): ";
+    cin >> departure_date;
+    Flight* flight = parse_date(departure_date, departure_day) ? calendar.find_flight(flight_number, departure_day) : nullptr;
+    if (flight) {
+        string out;
+        flight->append_flight_info(out);
+        append_fare_quotes(ScheduleLeg::of(flight), out);
+        cout << out;
+        return;
+    }
+    cout << "Flight not found" << endl;
+}
+
+// Announcement sent to a retimed flight's passengers; a literal, so it outlives delivery
+const char flight_retimed_text[] = "This flight has been retimed.";
+
+// Function to move a flight to new departure and arrival times
+void retime_flight(ScheduleCalendar& calendar) {
+    string flight_number, departure_date, departure_time, arrival_time;
+    int32_t day, departure, arrival;
+    cout << "Enter flight number: ";
+    cin >> flight_number;
+    cout << "Enter departure date (YYYY-MM-DD): ";
+    cin >> departure_date;
+    cout << "New departure (YYYY-MM-DD HH:MM): ";
+    cin >> ws;
+    getline(cin, departure_time);
+    cout << "New arrival (YYYY-MM-DD HH:MM): ";
+    getline(cin, arrival_time);
+    if (!parse_date(departure_date, day) || !parse_timestamp(departure_time, departure) || !parse_timestamp(arrival_time, arrival)) {
+        cout << "Invalid time" << endl;
+        return;
+    }
+    Flight* flight;
+    try {
+        flight = calendar.retime_flight(flight_number, day, departure, arrival);
+    } catch (const InvalidFlightTimeException& e) {
+        cout << e.what() << endl;
+        return;
+    }
+    if (!flight) {
+        cout << "Flight not found, or it cannot move to that date" << endl;
+        return;
+    }
+    flight->announce(flight_retimed_text);
+    cout << "Flight retimed" << endl;
+}
+
+// Function to cancel a flight and every booking on it
+void cancel_flight(ScheduleCalendar& calendar, BookingStore& bookings) {
+    string flight_number, departure_date;
+    int32_t day;
+    cout << "Enter flight number: ";
+    cin >> flight_number;
+    cout << "Enter departure date (YYYY-MM-DD): ";
+    cin >> departure_date;
+    if (!parse_date(departure_date, day) || !calendar.cancel_flight(flight_number, day, bookings)) {
+        cout << "Flight not found" << endl;
+        return;
+    }
+    cout << "Flight cancelled" << endl;
+}
+
+// Function to create the sample passengers, flights, bookings and itinerary
+ScheduleCalendar* create_sample_data(PassengerRegistry& passengers, BookingStore& bookings, vector<Itinerary*>& itineraries) {
+    // Creating initial passengers
+    PassengerHandle passenger1 = passengers.add_passenger("John Doe", "john@example.com", "1234567890", "P12345");
+    PassengerHandle passenger2 = passengers.add_passenger("Jane Smith", "jane@example.com", "0987654321", "P54321");
+
+    // Creating initial flights
+    Flight* flight1 = FlightFactory::create_flight(FlightType::Domestic, "FL123", "New York", "Los Angeles", "2023-06-15 10:00", "2023-06-15 14:00");
+    Flight* flight2 = FlightFactory::create_flight(FlightType::International, "FL456", "New York", "London", "2023-06-16 18:00", "2023-06-17 06:00");
+
+    // Creating initial bookings
+    Booking* booking1 = bookings.get(bookings.create_booking("B123", passengers, passenger1, flight1, "12A", BookingStatus::Confirmed));
+    Booking* booking2 = bookings.get(bookings.create_booking("B456", passengers, passenger2, flight2, "14B", BookingStatus::Confirmed));
+
+    // Attach passengers to flights as observers
+    flight1->attach(&passengers.get(passenger1));
+    flight2->attach(&passengers.get(passenger2));
+
+    // Creating itinerary
+    Itinerary* itinerary = new Itinerary("I123");
+    itinerary->add_booking(booking1);
+    itinerary->add_booking(booking2);
+    itineraries.push_back(itinerary);
+
+    // Creating the calendar: each flight goes to the day it departs, and a daily shuttle runs for a year
+    ScheduleCalendar* calendar = new ScheduleCalendar("S123");
+    calendar->add_flight(flight1);
+    calendar->add_flight(flight2);
+    int32_t first_day;
+    parse_date("2023-06-15", first_day);
+    calendar->add_recurring_flight(RecurringFlight{ FlightType::Domestic, "FL789", "New York", "Chicago", 7 * 60 + 30, 150,
+                                                    daily_except_sunday, first_day, first_day + 364 });
+    return calendar;
+}
+
+// Function to save the system state to a snapshot file. Saving over the snapshot the journal pairs with
+// covers every journaled change, so the journal is emptied.
+void save_snapshot(const ScheduleCalendar& calendar, const PassengerRegistry& passengers, const BookingStore& bookings,
+                   const vector<Itinerary*>& itineraries, const string& journal_snapshot_path) {
+    string path;
+    cout << "Enter snapshot file path: ";
+    cin >> path;
+    try {
+        write_snapshot(path, calendar, passengers, bookings, itineraries);
+        cout << "Snapshot saved to " << path << endl;
+        if (path == journal_snapshot_path && !BookingJournal::instance().truncate()) {
+            throw JournalException();
+        }
+    } catch (const SnapshotException& e) {
+        cout << e.what() << endl;
+    }
+}
+
+// Function to print the outcome of a CSV import
+void print_import_result(const ImportResult& result) {
+    double megabytes = result.bytes / (1024.0 * 1024.0);
+    cout << "Loaded " << result.rows_loaded << " rows, rejected " << result.rows_rejected << " rows" << endl;
+    cout << "Read " << megabytes << " MB in " << result.seconds << " s";
+    if (result.seconds > 0) {
+        cout << " (" << megabytes / result.seconds << " MB/s)";
+    }
+    cout << endl;
+}
+
+// Request server. Every frame on the wire is a u32 payload size followed by the payload, with integers in
+// host byte order as in the journal:
+//   request:  u32 request ID, u8 opcode, u8 field count, then per field a u32 length and its bytes
+//   response: u32 request ID, u8 opcode, u8 status, u32 body length and the body text
+// Requests on one connection run in the order sent and are answered in that order, so clients may pipeline;
+// requests on different connections run in parallel on the server's workers. Times are "YYYY-MM-DD HH:MM".
+enum class Opcode : uint8_t {
+    BookFlight = 1,      // passport number, flight number, departure date, seat number or "any", booking ID
+    CancelBooking = 2,   // booking ID
+    GetPassenger = 3,    // passport number
+    ModifyPassenger = 4, // passport number, email, phone number; an empty field keeps the current value
+    FlightDetails = 5,   // flight number, departure date
+    ListSchedule = 6,    // date
+    AddPassenger = 7,    // name, email, phone number, passport number
+    PlanJourney = 8,     // origin, destination, earliest departure time, maximum connections (at most 8), minimum connection minutes
+    RetimeFlight = 9,    // flight number, departure date, new departure time, new arrival time
+    CancelFlight = 10    // flight number, departure date
+};
+
+const uint8_t opcode_count = 11; // One past the largest opcode
+
+const char* opcode_name(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::BookFlight: return "BookFlight";
+    case Opcode::CancelBooking: return "CancelBooking";
+    case Opcode::GetPassenger: return "GetPassenger";
+    case Opcode::ModifyPassenger: return "ModifyPassenger";
+    case Opcode::FlightDetails: return "FlightDetails";
+    case Opcode::ListSchedule: return "ListSchedule";
+    case Opcode::AddPassenger: return "AddPassenger";
+    case Opcode::PlanJourney: return "PlanJourney";
+    case Opcode::RetimeFlight: return "RetimeFlight";
+    case Opcode::CancelFlight: return "CancelFlight";
+    }
+    return "Unknown";
+}
+
+enum class ResponseStatus : uint8_t {
+    Ok = 0,
+    NotFound = 1,
+    Rejected = 2,
+    BadRequest = 3,
+    Unavailable = 4 // The journal failed and the server is shutting down
+};
+
+const size_t max_frame_size = 64 * 1024;
+
+// A decoded request. Fields are kept as offsets into the request's own payload, so requests can be moved.
+struct Request {
+    static constexpr size_t max_fields = 5;
+
+    uint32_t request_id = 0;
+    Opcode opcode = Opcode::BookFlight;
+    uint8_t field_count = 0;
+    uint32_t field_offsets[max_fields] = {};
+    uint32_t field_sizes[max_fields] = {};
+    string payload;
+
+    string_view field(size_t i) const {
+        return string_view(payload).substr(field_offsets[i], field_sizes[i]);
+    }
+};
+
+void put_u32(string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t get_u32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void encode_request(string& out, uint32_t request_id, Opcode opcode, initializer_list<string_view> fields) {
+    size_t start = out.size();
+    out.resize(start + 4);
+    put_u32(out, request_id);
+    out += static_cast<char>(opcode);
+    out += static_cast<char>(fields.size());
+    for (string_view field : fields) {
+        put_u32(out, static_cast<uint32_t>(field.size()));
+        out.append(field.data(), field.size());
+    }
+    uint32_t payload_size = static_cast<uint32_t>(out.size() - start - 4);
+    memcpy(&out[start], &payload_size, sizeof(payload_size));
+}
+
+void encode_response(string& out, uint32_t request_id, Opcode opcode, ResponseStatus status, string_view body) {
+    put_u32(out, static_cast<uint32_t>(10 + body.size()));
+    put_u32(out, request_id);
+    out += static_cast<char>(opcode);
+    out += static_cast<char>(status);
+    put_u32(out, static_cast<uint32_t>(body.size()));
+    out.append(body.data(), body.size());
+}
+
+// Decode a request payload; false if it is malformed or has an unknown opcode
+bool decode_request(string&& payload, Request& request) {
+    if (payload.size() < 6) {
+        return false;
+    }
+    request.payload = move(payload);
+    const string& data = request.payload;
+    request.request_id = get_u32(data.data());
+    uint8_t opcode = static_cast<uint8_t>(data[4]);
+    request.field_count = static_cast<uint8_t>(data[5]);
+    if (opcode == 0 || opcode >= opcode_count || request.field_count > Request::max_fields) {
+        return false;
+    }
+    request.opcode = static_cast<Opcode>(opcode);
+    size_t offset = 6;
+    for (size_t i = 0; i < request.field_count; ++i) {
+        if (data.size() - offset < 4) {
+            return false;
+        }
+        uint32_t size = get_u32(data.data() + offset);
+        offset += 4;
+        if (size > data.size() - offset) {
+            return false;
+        }
+        request.field_offsets[i] = static_cast<uint32_t>(offset);
+        request.field_sizes[i] = size;
+        offset += size;
+    }
+    return offset == data.size();
+}
+
+// Fill a socket address for an endpoint: "tcp:PORT" is that port on the loopback interface, anything else
+// is a Unix socket path. Returns the address length, or 0 if the endpoint is invalid.
+socklen_t resolve_endpoint(const string& endpoint, sockaddr_storage& address) {
+    memset(&address, 0, sizeof(address));
+    if (endpoint.compare(0, 4, "tcp:") == 0) {
+        char* end;
+        long port = strtol(endpoint.c_str() + 4, &end, 10);
+        if (endpoint.size() == 4 || *end || port <= 0 || port > 65535) {
+            return 0;
+        }
+        sockaddr_in& in = reinterpret_cast<sockaddr_in&>(address);
+        in.sin_family = AF_INET;
+        in.sin_port = htons(static_cast<uint16_t>(port));
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return sizeof(sockaddr_in);
+    }
+    sockaddr_un& un = reinterpret_cast<sockaddr_un&>(address);
+    if (endpoint.empty() || endpoint.size() >= sizeof(un.sun_path)) {
+        return 0;
+    }
+    un.sun_family = AF_UNIX;
+    memcpy(un.sun_path, endpoint.c_str(), endpoint.size() + 1);
+    return sizeof(sockaddr_un);
+}
+
+// Connect to an endpoint with a blocking socket; -1 on failure
+int connect_to(const string& endpoint) {
+    sockaddr_storage address;
+    socklen_t length = resolve_endpoint(endpoint, address);
+    if (!length) {
+        return -1;
+    }
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), length) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (address.ss_family == AF_INET) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+// The state the server's requests work on. Readers hold state_mutex shared and writers hold it exclusively.
+struct FlightSystem {
+    ScheduleCalendar& calendar;
+    PassengerRegistry& passengers;
+    BookingStore& bookings;
+    Itinerary* itinerary;
+    shared_mutex state_mutex;
+
+    FlightSystem(ScheduleCalendar& calendar, PassengerRegistry& passengers, BookingStore& bookings, Itinerary* itinerary)
+        : calendar(calendar), passengers(passengers), bookings(bookings), itinerary(itinerary) {}
+};
+
+// Read the newest calendar version covering departures in [from_minutes, to_minutes) without taking the state
+// lock, so reads never wait for writers. Only when a recurring flight has yet to be expanded into one of the
+// days is the exclusive lock taken, to expand and publish them before reading.
+template <typename Read>
+ResponseStatus read_range(FlightSystem& system, int32_t from_minutes, int32_t to_minutes, Read read) {
+    {
+        EpochGuard guard;
+        const CalendarSnapshot& snapshot = system.calendar.get_snapshot();
+        if (!snapshot.range_needs_expansion(from_minutes, to_minutes)) {
+            return read(snapshot);
+        }
+    }
+    {
+        unique_lock<shared_mutex> lock(system.state_mutex);
+        system.calendar.expand_range(from_minutes, to_minutes);
+    }
+    EpochGuard guard;
+    return read(system.calendar.get_snapshot());
+}
+
+// Parse a request field holding a small non-negative number
+bool parse_count(string_view text, int& value) {
+    if (text.empty() || text.size() > 6) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Run one request against the system, writing the response text to body.
+// Changes go through the same journaled paths as the menu; JournalException propagates to the caller.
+// Call it inside a BookingJournal::DeferredCommits scope so no journal sync is waited for under the state lock.
+ResponseStatus handle_request(FlightSystem& system, const Request& request, string& body) {
+    INSTRUMENT_SCOPE(Probe::ServerRequest);
+    static const uint8_t field_counts[opcode_count] = { 0, 5, 1, 1, 3, 2, 1, 4, 5, 4, 2 };
+    if (request.field_count != field_counts[static_cast<uint8_t>(request.opcode)]) {
+        body = "Wrong number of fields";
+        return ResponseStatus::BadRequest;
+    }
+    int32_t day;
+    switch (request.opcode) {
+    case Opcode::BookFlight:
+        {
+            if (!parse_date(request.field(2), day)) {
+                body = "Invalid date";
+                return ResponseStatus::BadRequest;
+            }
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            PassengerHandle passenger = system.passengers.find(request.field(0));
+            if (!passenger.is_valid()) {
+                body = "Passenger not found";
+                return ResponseStatus::NotFound;
+            }
+            Flight* flight = system.calendar.find_flight(request.field(1), day);
+            if (!flight) {
+                body = FlightNotFoundException().what();
+                return ResponseStatus::NotFound;
+            }
+            if (!flight->check_availability()) {
+                body = "Flight is full";
+                return ResponseStatus::Rejected;
+            }
+            string seat_number(request.field(3));
+            if (seat_number == "any") {
+                seat_number = flight->get_seat_map().seat_label(flight->get_seat_map().next_free_seat());
+            }
+            try {
+                Booking* booking = system.bookings.get(system.bookings.create_booking(
+                    string(request.field(4)), system.passengers, passenger, flight, seat_number, BookingStatus::Pending));
+                if (!booking) {
+                    body = "Booking ID already exists";
+                    return ResponseStatus::Rejected;
+                }
+                flight->attach(&system.passengers.get(passenger));
+                system.itinerary->add_booking(booking);
+                booking->confirm_booking();
+                booking->append_booking_info(body);
+                return ResponseStatus::Ok;
+            } catch (const SeatUnavailableException& e) {
+                body = e.what();
+                return ResponseStatus::Rejected;
+            }
+        }
+    case Opcode::CancelBooking:
+        {
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            if (!cancel_booking(system.bookings, request.field(0))) {
+                body = "Booking not found";
+                return ResponseStatus::NotFound;
+            }
+            body = "Booking cancelled";
+            return ResponseStatus::Ok;
+        }
+    case Opcode::GetPassenger:
+        {
+            shared_lock<shared_mutex> lock(system.state_mutex);
+            PassengerHandle passenger = system.passengers.find(request.field(0));
+            if (!passenger.is_valid()) {
+                body = "Passenger not found";
+                return ResponseStatus::NotFound;
+            }
+            system.passengers.get(passenger).append_passenger_info(body);
+            return ResponseStatus::Ok;
+        }
+    case Opcode::ModifyPassenger:
+        {
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            PassengerHandle handle = system.passengers.find(request.field(0));
+            if (!handle.is_valid()) {
+                body = "Passenger not found";
+                return ResponseStatus::NotFound;
+            }
+            Passenger& passenger = system.passengers.get(handle);
+            if (!request.field(1).empty()) {
+                passenger.set_email(string(request.field(1)));
+            }
+            if (!request.field(2).empty()) {
+                passenger.set_phone_number(string(request.field(2)));
+            }
+            passenger.append_passenger_info(body);
+            return ResponseStatus::Ok;
+        }
+    case Opcode::FlightDetails:
+        if (!parse_date(request.field(1), day)) {
+            body = "Invalid date";
+            return ResponseStatus::BadRequest;
+        }
+        return read_range(system, day * 1440, day * 1440 + 1440, [&](const CalendarSnapshot& snapshot) {
+            const ScheduleSnapshot* schedule = snapshot.find_day(day);
+            const ScheduleLeg* leg = schedule ? schedule->find_leg(request.field(0)) : nullptr;
+            if (!leg) {
+                body = "Flight not found";
+                return ResponseStatus::NotFound;
+            }
+            leg->append_leg_info(body);
+            append_fare_quotes(*leg, body);
+            return ResponseStatus::Ok;
+        });
+    case Opcode::ListSchedule:
+        if (!parse_date(request.field(0), day)) {
+            body = "Invalid date";
+            return ResponseStatus::BadRequest;
+        }
+        return read_range(system, day * 1440, day * 1440 + 1440, [&](const CalendarSnapshot& snapshot) {
+            const ScheduleSnapshot* schedule = snapshot.find_day(day);
+            if (!schedule) {
+                body = "No flights depart on that date";
+                return ResponseStatus::NotFound;
+            }
+            schedule->append_schedule_details(body);
+            return ResponseStatus::Ok;
+        });
+    case Opcode::AddPassenger:
+        {
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            PassengerHandle passenger = system.passengers.add_passenger(string(request.field(0)), string(request.field(1)),
+                                                                        string(request.field(2)), string(request.field(3)));
+            if (!passenger.is_valid()) {
+                body = "Passport number already registered";
+                return ResponseStatus::Rejected;
+            }
+            // Passengers are otherwise made durable with their first booking; a client is told only once it is
+            BookingJournal::instance().sync();
+            system.passengers.get(passenger).append_passenger_info(body);
+            return ResponseStatus::Ok;
+        }
+    case Opcode::PlanJourney:
+        {
+            int32_t depart_after;
+            int max_connections, min_connection_minutes;
+            if (!parse_timestamp(request.field(2), depart_after) || !parse_count(request.field(3), max_connections) ||
+                max_connections > JourneyPlanner::connection_limit || !parse_count(request.field(4), min_connection_minutes)) {
+                body = "Invalid journey parameters";
+                return ResponseStatus::BadRequest;
+            }
+            string origin(request.field(0)), destination(request.field(1));
+            return read_range(system, depart_after, journey_window_end(depart_after), [&](const CalendarSnapshot& snapshot) {
+                if (!append_journey(snapshot, origin, destination, depart_after, max_connections, min_connection_minutes, body)) {
+                    body = "No journey found";
+                    return ResponseStatus::NotFound;
+                }
+                return ResponseStatus::Ok;
+            });
+        }
+    case Opcode::RetimeFlight:
+        {
+            int32_t departure, arrival;
+            if (!parse_date(request.field(1), day) || !parse_timestamp(request.field(2), departure) ||
+                !parse_timestamp(request.field(3), arrival) || arrival < departure) {
+                body = "Invalid flight times";
+                return ResponseStatus::BadRequest;
+            }
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            Flight* flight = system.calendar.retime_flight(request.field(0), day, departure, arrival);
+            if (!flight) {
+                body = "Flight not found, or it cannot move to that date";
+                return ResponseStatus::NotFound;
+            }
+            flight->announce(flight_retimed_text);
+            body = "Flight retimed";
+            return ResponseStatus::Ok;
+        }
+    case Opcode::CancelFlight:
+        {
+            if (!parse_date(request.field(1), day)) {
+                body = "Invalid date";
+                return ResponseStatus::BadRequest;
+            }
+            unique_lock<shared_mutex> lock(system.state_mutex);
+            if (!system.calendar.cancel_flight(request.field(0), day, system.bookings)) {
+                body = FlightNotFoundException().what();
+                return ResponseStatus::NotFound;
+            }
+            body = "Flight cancelled";
+            return ResponseStatus::Ok;
+        }
+    }
+    body = "Unknown opcode";
+    return ResponseStatus::BadRequest;
+}
+
+// RequestServer class serving the request protocol on one socket.
+// One I/O thread runs an epoll loop that accepts connections, reads and decodes frames and writes responses.
+// Decoded requests queue on their connection, and a connection with queued requests is handed to one worker
+// at a time, so each connection's requests run in order while different connections run in parallel.
+// Workers hand finished responses back to the I/O thread through an eventfd.
+class RequestServer {
+private:
+    static constexpr size_t max_pipeline_depth = 1024; // Queued requests per connection before reading pauses
+    static constexpr size_t read_chunk_size = 64 * 1024;
+
+    struct Connection {
+        int fd;
+        // I/O thread only
+        string input;
+        size_t input_offset = 0;
+        string sending;
+        size_t sent = 0;
+        uint32_t interest = 0;
+
+        // Shared with the workers
+        mutex connection_mutex;
+        deque<Request> inbox;
+        string outbox;
+        size_t queued = 0;      // Requests read but not yet answered
+        bool scheduled = false; // In the run queue or being served by a worker
+        bool closed = false;
+
+        explicit Connection(int fd) : fd(fd) {}
+    };
+
+    FlightSystem& system;
+    size_t worker_count;
+    string endpoint;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    int signal_fd;
+    unordered_map<int, shared_ptr<Connection>> connections; // I/O thread only
+    vector<char> read_buffer;                                // I/O thread only
+
+    vector<thread> workers;
+    mutex run_mutex;
+    condition_variable run_ready;
+    deque<shared_ptr<Connection>> run_queue;
+    bool stopping;
+
+    mutex ready_mutex;
+    vector<shared_ptr<Connection>> ready; // Connections with new responses in their outbox
+    atomic<bool> journal_failed;
+
+    // Metrics
+    atomic<uint64_t> requests_served;
+    uint64_t connections_accepted;
+    uint64_t protocol_errors;
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t written = ::write(wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void watch(int fd, uint32_t events, int operation) {
+        epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, operation, fd, &event);
+    }
+
+    void close_connection(const shared_ptr<Connection>& connection) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+        ::close(connection->fd);
+        {
+            lock_guard<mutex> lock(connection->connection_mutex);
+            connection->closed = true;
+        }
+        connections.erase(connection->fd);
+    }
+
+    // Read while a connection is under its pipeline depth, and wait to write while it has unsent output
+    void update_interest(Connection& connection) {
+        size_t queued;
+        {
+            lock_guard<mutex> lock(connection.connection_mutex);
+            queued = connection.queued;
+        }
+        uint32_t interest = 0;
+        if (queued < max_pipeline_depth) {
+            interest |= EPOLLIN;
+        }
+        if (connection.sent < connection.sending.size()) {
+            interest |= EPOLLOUT;
+        }
+        if (interest != connection.interest) {
+            connection.interest = interest;
+            watch(connection.fd, interest, EPOLL_CTL_MOD);
+        }
+    }
+
+    void accept_connections() {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            auto connection = make_shared<Connection>(fd);
+            connection->interest = EPOLLIN;
+            connections.emplace(fd, connection);
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+            ++connections_accepted;
+        }
+    }
+
+    // Read what the socket has, decode every complete frame and queue the requests for a worker.
+    // Returns false if the connection was closed.
+    bool read_from(const shared_ptr<Connection>& connection) {
+        string& input = connection->input;
+        bool peer_closed = false;
+        for (;;) {
+            ssize_t received = recv(connection->fd, read_buffer.data(), read_buffer.size(), 0);
+            if (received > 0) {
+                input.append(read_buffer.data(), received);
+                continue;
+            }
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            peer_closed = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+
+        deque<Request> requests;
+        while (input.size() - connection->input_offset >= 4) {
+            uint32_t payload_size = get_u32(input.data() + connection->input_offset);
+            if (payload_size > max_frame_size) {
+                ++protocol_errors;
+                close_connection(connection);
+                return false;
+            }
+            if (input.size() - connection->input_offset - 4 < payload_size) {
+                break;
+            }
+            Request request;
+            if (!decode_request(input.substr(connection->input_offset + 4, payload_size), request)) {
+                ++protocol_errors;
+                close_connection(connection);
+                return false;
+            }
+            requests.push_back(move(request));
+            connection->input_offset += 4 + payload_size;
+        }
+        input.erase(0, connection->input_offset);
+        connection->input_offset = 0;
+
+        if (!requests.empty()) {
+            bool schedule;
+            {
+                lock_guard<mutex> lock(connection->connection_mutex);
+                connection->queued += requests.size();
+                for (auto& request : requests) {
+                    connection->inbox.push_back(move(request));
+                }
+                schedule = !connection->scheduled;
+                connection->scheduled = true;
+            }
+            if (schedule) {
+                {
+                    lock_guard<mutex> lock(run_mutex);
+                    run_queue.push_back(connection);
+                }
+                run_ready.notify_one();
+            }
+        }
+        // Responses still owed are dropped with the connection
+        if (peer_closed) {
+            close_connection(connection);
+            return false;
+        }
+        update_interest(*connection);
+        return true;
+    }
+
+    // Send queued responses until the socket would block
+    void write_to(const shared_ptr<Connection>& connection) {
+        for (;;) {
+            if (connection->sent == connection->sending.size()) {
+                connection->sending.clear();
+                connection->sent = 0;
+                lock_guard<mutex> lock(connection->connection_mutex);
+                connection->sending.swap(connection->outbox);
+            }
+            if (connection->sending.empty()) {
+                break;
+            }
+            ssize_t written = send(connection->fd, connection->sending.data() + connection->sent,
+                                   connection->sending.size() - connection->sent, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                close_connection(connection);
+                return;
+            }
+            connection->sent += written;
+        }
+        update_interest(*connection);
+    }
+
+    void flush_ready() {
+        uint64_t count;
+        ssize_t received = ::read(wake_fd, &count, sizeof(count));
+        (void)received;
+        vector<shared_ptr<Connection>> batch;
+        {
+            lock_guard<mutex> lock(ready_mutex);
+            batch.swap(ready);
+        }
+        for (auto& connection : batch) {
+            bool closed;
+            {
+                lock_guard<mutex> lock(connection->connection_mutex);
+                closed = connection->closed;
+            }
+            if (!closed) {
+                write_to(connection);
+            }
+        }
+    }
+
+    // Run one batch of a connection's queued requests, then requeue the connection behind the others if more
+    // arrived meanwhile, so a busy connection cannot hold a worker
+    void serve(const shared_ptr<Connection>& connection) {
+        deque<Request> batch;
+        {
+            lock_guard<mutex> lock(connection->connection_mutex);
+            batch.swap(connection->inbox);
+        }
+        string output;
+        string body;
+        // The batch's changes are made durable together, after handle_request has released the state lock
+        BookingJournal::DeferredCommits commits;
+        for (const auto& request : batch) {
+            ResponseStatus status;
+            body.clear();
+            try {
+                status = handle_request(system, request, body);
+            } catch (const JournalException& e) {
+                body = e.what();
+                status = ResponseStatus::Unavailable;
+                journal_failed.store(true, memory_order_release);
+            }
+            encode_response(output, request.request_id, request.opcode, status, body);
+        }
+        try {
+            commits.wait();
+        } catch (const JournalException& e) {
+            // Changes can no longer be made durable, so none of the batch is reported done and no more are taken
+            output.clear();
+            for (const auto& request : batch) {
+                encode_response(output, request.request_id, request.opcode, ResponseStatus::Unavailable, e.what());
+            }
+            journal_failed.store(true, memory_order_release);
+        }
+        requests_served.fetch_add(batch.size(), memory_order_relaxed);
+
+        bool requeue;
+        {
+            lock_guard<mutex> lock(connection->connection_mutex);
+            connection->outbox += output;
+            connection->queued -= batch.size();
+            requeue = !connection->inbox.empty() && !connection->closed;
+            connection->scheduled = requeue;
+        }
+        if (requeue) {
+            lock_guard<mutex> lock(run_mutex);
+            run_queue.push_back(connection);
+        }
+        {
+            lock_guard<mutex> lock(ready_mutex);
+            ready.push_back(connection);
+        }
+        wake();
+    }
+
+    void run_worker() {
+        for (;;) {
+            shared_ptr<Connection> connection;
+            {
+                unique_lock<mutex> lock(run_mutex);
+                run_ready.wait(lock, [this] { return stopping || !run_queue.empty(); });
+                if (run_queue.empty()) {
+                    return;
+                }
+                connection = move(run_queue.front());
+                run_queue.pop_front();
+            }
+            serve(connection);
+        }
+    }
+
+public:
+    RequestServer(FlightSystem& system, size_t worker_count)
+        : system(system), worker_count(max<size_t>(1, worker_count)), listen_fd(-1), epoll_fd(-1), wake_fd(-1), signal_fd(-1),
+          read_buffer(read_chunk_size), stopping(false), journal_failed(false), requests_served(0), connections_accepted(0), protocol_errors(0) {}
+    RequestServer(const RequestServer&) = delete;
+    RequestServer& operator=(const RequestServer&) = delete;
+
+    ~RequestServer() {
+        for (int fd : { listen_fd, epoll_fd, wake_fd, signal_fd }) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    // Block SIGINT and SIGTERM so run() can take them as a request to stop. Threads inherit the mask,
+    // so call this before any thread is started.
+    static void block_stop_signals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+
+    // Bind and listen on an endpoint, replacing a stale Unix socket file; false on failure
+    bool listen(const string& new_endpoint) {
+        sockaddr_storage address;
+        socklen_t length = resolve_endpoint(new_endpoint, address);
+        if (!length) {
+            return false;
+        }
+        endpoint = new_endpoint;
+        listen_fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            return false;
+        }
+        if (address.ss_family == AF_UNIX) {
+            unlink(endpoint.c_str());
+        } else {
+            int on = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), length) != 0 || ::listen(listen_fd, SOMAXCONN) != 0) {
+            return false;
+        }
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (epoll_fd < 0 || wake_fd < 0 || signal_fd < 0) {
+            return false;
+        }
+        watch(listen_fd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wake_fd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(signal_fd, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
+    }
+
+    // Serve until SIGINT or SIGTERM arrives or the journal fails; then finish the requests already running
+    void run() {
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers.emplace_back(&RequestServer::run_worker, this);
+        }
+        const int max_events = 64;
+        epoll_event events[max_events];
+        bool running = true;
+        while (running && !journal_failed.load(memory_order_acquire)) {
+            int count = epoll_wait(epoll_fd, events, max_events, -1);
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    accept_connections();
+                } else if (fd == wake_fd) {
+                    flush_ready();
+                } else if (fd == signal_fd) {
+                    running = false;
+                } else {
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) {
+                        continue;
+                    }
+                    shared_ptr<Connection> connection = it->second;
+                    if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !read_from(connection)) {
+                        continue;
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        write_to(connection);
+                    }
+                }
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(run_mutex);
+            stopping = true;
+        }
+        run_ready.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        while (!connections.empty()) {
+            close_connection(connections.begin()->second);
+        }
+        if (endpoint.compare(0, 4, "tcp:") != 0) {
+            unlink(endpoint.c_str());
+        }
+    }
+
+    // Display requests served, connections accepted and protocol errors
+    void get_server_stats() const {
+        cout << "Requests served: " << requests_served.load() << ", Connections accepted: " << connections_accepted
+            << ", Protocol errors: " << protocol_errors << endl;
+    }
+};
+
+// Latencies of one request type, in nanoseconds, and how many were not answered Ok
+struct OperationLatencies {
+    vector<uint64_t> latencies;
+    uint64_t errors = 0;
+};
+
+// Closed-loop load generator. Each connection registers its own passenger, then keeps depth requests in flight
+// until the run ends, cycling through book, flight details, passenger lookup, schedule listing, cancellation and
+// passenger modification on one flight; it then prints requests per second and latency percentiles per operation.
+int run_loadgen(const string& endpoint, const string& flight_number, const string& date, size_t connection_count,
+                int seconds, size_t depth) {
+    int32_t day;
+    if (!parse_date(date, day)) {
+        cout << "Invalid date: " << date << endl;
+        return 1;
+    }
+    depth = max<size_t>(1, depth);
+    string run_id = to_string(getpid());
+    vector<array<OperationLatencies, opcode_count>> results(connection_count);
+    atomic<size_t> failed_connections(0);
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+
+    auto run_connection = [&](size_t c) {
+        array<OperationLatencies, opcode_count>& result = results[c];
+        int fd = connect_to(endpoint);
+        if (fd < 0) {
+            failed_connections.fetch_add(1);
+            return;
+        }
+        string passport_number = "LG" + run_id + "-" + to_string(c);
+        string booking_prefix = "LGB" + run_id + "-" + to_string(c) + "-";
+        vector<chrono::steady_clock::time_point> sent_at(depth);
+        string output;
+        string input;
+        size_t input_offset = 0;
+        uint64_t next_id = 0;
+        size_t in_flight = 0;
+
+        // The request with a given ID; the i-th cycle books and later cancels booking i
+        auto encode_next = [&]() {
+            uint32_t id = static_cast<uint32_t>(next_id);
+            string booking_id = booking_prefix + to_string(next_id / 6);
+            switch (next_id % 6) {
+            case 0:
+                encode_request(output, id, Opcode::BookFlight, { passport_number, flight_number, date, "any", booking_id });
+                break;
+            case 1:
+                encode_request(output, id, Opcode::FlightDetails, { flight_number, date });
+                break;
+            case 2:
+                encode_request(output, id, Opcode::GetPassenger, { passport_number });
+                break;
+            case 3:
+                encode_request(output, id, Opcode::ListSchedule, { date });
+                break;
+            case 4:
+                encode_request(output, id, Opcode::CancelBooking, { booking_id });
+                break;
+            default:
+                encode_request(output, id, Opcode::ModifyPassenger, { passport_number, "", to_string(next_id) });
+            }
+            sent_at[next_id % depth] = chrono::steady_clock::now();
+            ++next_id;
+            ++in_flight;
+        };
+        auto send_all = [&]() {
+            size_t offset = 0;
+            while (offset < output.size()) {
+                ssize_t written = send(fd, output.data() + offset, output.size() - offset, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    return false;
+                }
+                offset += written;
+            }
+            output.clear();
+            return true;
+        };
+
+        // Register the passenger before the clock starts; it may exist from an earlier run
+        encode_request(output, UINT32_MAX, Opcode::AddPassenger, { "Load Generator", "loadgen@example.com", "0", passport_number });
+        bool ok = send_all();
+        char buffer[64 * 1024];
+        while (ok) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                ok = false;
+                break;
+            }
+            input.append(buffer, received);
+            if (input.size() >= 4 && input.size() - 4 >= get_u32(input.data())) {
+                input.erase(0, 4 + get_u32(input.data()));
+                break;
+            }
+        }
+
+        while (ok && in_flight < depth) {
+            encode_next();
+        }
+        ok = ok && send_all();
+        while (ok && in_flight > 0) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            input.append(buffer, received);
+            auto now = chrono::steady_clock::now();
+            bool sending = now < deadline;
+            while (input.size() - input_offset >= 4) {
+                uint32_t payload_size = get_u32(input.data() + input_offset);
+                if (input.size() - input_offset - 4 < payload_size) {
+                    break;
+                }
+                const char* payload = input.data() + input_offset + 4;
+                uint32_t id = get_u32(payload);
+                uint8_t opcode = static_cast<uint8_t>(payload[4]);
+                ResponseStatus status = static_cast<ResponseStatus>(payload[5]);
+                if (opcode < opcode_count) {
+                    result[opcode].latencies.push_back(static_cast<uint64_t>(
+                        chrono::duration_cast<chrono::nanoseconds>(now - sent_at[id % depth]).count()));
+                    result[opcode].errors += status != ResponseStatus::Ok;
+                }
+                input_offset += 4 + payload_size;
+                --in_flight;
+                if (sending) {
+                    encode_next();
+                }
+            }
+            input.erase(0, input_offset);
+            input_offset = 0;
+            ok = send_all();
+        }
+        if (in_flight > 0) {
+            failed_connections.fetch_add(1);
+        }
+        ::close(fd);
+    };
+
+    auto started = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (size_t c = 0; c < connection_count; ++c) {
+        threads.emplace_back(run_connection, c);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    if (failed_connections.load()) {
+        cout << failed_connections.load() << " of " << connection_count << " connections failed" << endl;
+    }
+
+    cout << "Connections: " << connection_count << ", Pipeline depth: " << depth << ", Seconds: " << elapsed << endl;
+    cout << left << setw(16) << "Operation" << right << setw(10) << "Requests" << setw(12) << "Req/s" << setw(8) << "Errors"
+        << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "p99.9 us" << setw(10) << "max us" << endl;
+    uint64_t total = 0;
+    for (uint8_t opcode = 1; opcode < opcode_count; ++opcode) {
+        vector<uint64_t> latencies;
+        uint64_t errors = 0;
+        for (auto& result : results) {
+            latencies.insert(latencies.end(), result[opcode].latencies.begin(), result[opcode].latencies.end());
+            errors += result[opcode].errors;
+        }
+        if (latencies.empty()) {
+            continue;
+        }
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) {
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))] / 1000.0;
+        };
+        total += latencies.size();
+        cout << left << setw(16) << opcode_name(static_cast<Opcode>(opcode)) << right << setw(10) << latencies.size()
+            << setw(12) << static_cast<uint64_t>(latencies.size() / elapsed) << setw(8) << errors
+            << setw(10) << percentile(0.5) << setw(10) << percentile(0.9) << setw(10) << percentile(0.99)
+            << setw(10) << percentile(0.999) << setw(10) << latencies.back() / 1000.0 << endl;
+    }
+    cout << "Total: " << total << " requests, " << static_cast<uint64_t>(total / elapsed) << " req/s" << endl;
+    return failed_connections.load() ? 1 : 0;
+}
+
+// Randomized check of the booking ledger. Runs a seeded sequence of random steps on a scratch calendar: booking,
+// confirming, cancelling and removing bookings, retiming and cancelling flights, and evicting days. After every
+// step the ledger must match a full scan, and each flight must count exactly the cancellations made on it.
+// Prints the failing step and returns 1 on the first mismatch, so a seed reproduces it.
+int run_check_totals(uint32_t seed, size_t steps) {
+    mt19937 rng(seed);
+    PassengerRegistry passengers;
+    BookingStore bookings;
+    vector<Itinerary*> itineraries = { new Itinerary("CHECK") };
+    Itinerary* itinerary = itineraries.front();
+    ScheduleCalendar* calendar = new ScheduleCalendar("CHECK");
+    int32_t first_day;
+    parse_date("2023-06-15", first_day);
+    calendar->add_recurring_flight(RecurringFlight{ FlightType::Domestic, "CHK100", "Alpha", "Bravo", 600, 120, every_day, first_day, first_day + 30 });
+    calendar->add_recurring_flight(RecurringFlight{ FlightType::International, "CHK200", "Alpha", "Charlie", 900, 400, every_day, first_day, first_day + 30 });
+    vector<PassengerHandle> travellers;
+    for (int i = 0; i < 20; ++i) {
+        travellers.push_back(passengers.add_passenger("Check Passenger", "check@example.com", "0", "CHK" + to_string(i)));
+    }
+
+    unordered_map<const Flight*, uint32_t> cancellations; // Cancellations made on each scheduled flight
+    int32_t first_kept_day = first_day;
+    size_t next_booking = 0;
+    size_t failed_step = SIZE_MAX;
+    const char* names[] = { "CHK100", "CHK200", "CHK300", "CHK400", "CHK500" };
+    auto random_flight_number = [&]() { return string(names[rng() % 5]); };
+    auto random_day = [&]() { return first_kept_day + static_cast<int32_t>(rng() % 40); };
+    auto random_booking = [&]() { return bookings.size() ? bookings.at(rng() % bookings.size()) : nullptr; };
+
+    for (size_t step = 0; step < steps && failed_step == SIZE_MAX; ++step) {
+        uint32_t roll = rng() % 100;
+        try {
+            if (roll < 40) {
+                // Book a random status on a flight, scheduling a one-off flight if the number has no leg that day
+                string flight_number = random_flight_number();
+                int32_t day = random_day();
+                Flight* flight = calendar->find_flight(flight_number, day);
+                if (!flight && day >= first_kept_day) {
+                    FlightType kind = rng() % 2 ? FlightType::Domestic : FlightType::International;
+                    flight = FlightFactory::create_flight(kind, flight_number, "Alpha", rng() % 2 ? "Bravo" : "Charlie",
+                                                          day * 1440 + 480, day * 1440 + 720);
+                    if (!calendar->add_flight(flight)) {
+                        FlightFactory::destroy_flight(flight);
+                        flight = nullptr;
+                    }
+                }
+                if (flight && flight->check_availability()) {
+                    BookingStatus status = static_cast<BookingStatus>(rng() % 3);
+                    string seat_number = flight->get_seat_map().seat_label(flight->get_seat_map().next_free_seat());
+                    Booking* booking = bookings.get(bookings.create_booking("CHKB" + to_string(next_booking++), passengers,
+                        travellers[rng() % travellers.size()], flight, seat_number, status));
+                    if (booking) {
+                        itinerary->add_booking(booking);
+                        cancellations[flight] += status == BookingStatus::Cancelled;
+                    }
+                }
+            } else if (roll < 80) {
+                // Change a booking's status, or cancel and remove it
+                Booking* booking = random_booking();
+                if (booking) {
+                    const Flight* flight = booking->get_flight();
+                    bool was_cancelled = booking->get_booking_status() == BookingStatus::Cancelled;
+                    switch (rng() % 4) {
+                    case 0:
+                        booking->confirm_booking();
+                        break;
+                    case 1:
+                        booking->cancel_booking();
+                        break;
+                    case 2:
+                        booking->set_booking_status(static_cast<BookingStatus>(rng() % 3));
+                        break;
+                    default:
+                        cancel_booking(bookings, booking->get_booking_id());
+                        booking = nullptr;
+                    }
+                    cancellations[flight] += !was_cancelled && (!booking || booking->get_booking_status() == BookingStatus::Cancelled);
+                }
+            } else if (roll < 92) {
+                int32_t new_day = random_day();
+                calendar->retime_flight(random_flight_number(), random_day(), new_day * 1440 + static_cast<int32_t>(rng() % 1000),
+                                        new_day * 1440 + 1100);
+            } else if (roll < 98) {
+                string flight_number = random_flight_number();
+                int32_t day = random_day();
+                Flight* flight = calendar->find_flight(flight_number, day);
+                if (flight) {
+                    cancellations.erase(flight);
+                    calendar->cancel_flight(flight_number, day, bookings);
+                }
+            } else {
+                first_kept_day += rng() % 2;
+                for (auto it = cancellations.begin(); it != cancellations.end();) {
+                    it = day_of(it->first->get_departure_minutes()) < first_kept_day ? cancellations.erase(it) : next(it);
+                }
+                calendar->evict_before(first_kept_day, bookings);
+            }
+        } catch (const InvalidStatusTransitionException&) {
+            // A random status change the state machine rejects; nothing was applied
+        }
+
+        size_t mismatches = verify_booking_totals(*calendar, bookings);
+        for (const auto& entry : cancellations) {
+            mismatches += entry.first->get_booking_totals().get_bookings(BookingStatus::Cancelled) != entry.second;
+        }
+        if (mismatches) {
+            cout << mismatches << " booking totals differ after step " << step << " of seed " << seed << endl;
+            failed_step = step;
+        }
+    }
+    if (failed_step == SIZE_MAX) {
+        cout << "Booking totals matched after all " << steps << " steps of seed " << seed << ", " << next_booking
+            << " bookings made" << endl;
+    }
+
+    bookings.clear();
+    for (auto* owned_itinerary : itineraries) {
+        delete owned_itinerary;
+    }
+    delete calendar;
+    return failed_step == SIZE_MAX ? 0 : 1;
+}
+
+// Latency percentile, in microseconds, of nanosecond samples sorted in ascending order
+double percentile_us(const vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))] / 1000.0;
+}
+
+// Thread counts a benchmark scales over: 1, 2, 4, ... up to and including max_threads
+vector<size_t> bench_thread_counts(size_t max_threads) {
+    vector<size_t> counts;
+    for (size_t n = 1; n < max_threads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// Nanoseconds elapsed since a steady-clock time point
+double nanoseconds_since(chrono::steady_clock::time_point started) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - started).count();
+}
+
+// Flight lookup benchmark. For 1k, 100k and 1M flights on one day, times lookups of random scheduled flight
+// numbers through the schedule's hash index against the linear scan it replaced, which copied the flight list
+// and compared numbers until it found a match.
+int run_bench_lookup() {
+    const size_t lookup_count = 200000;
+    mt19937 rng(1);
+    cout << right << setw(10) << "Flights" << setw(16) << "Index ns/op" << setw(16) << "Scan ns/op" << setw(12) << "Speedup" << endl;
+    for (size_t flight_count : { size_t(1000), size_t(100000), size_t(1000000) }) {
+        Schedule schedule("BENCH", "2023-06-15");
+        vector<Flight*> flights;
+        flights.reserve(flight_count);
+        for (size_t i = 0; i < flight_count; ++i) {
+            int32_t departure = 19523 * 1440 + static_cast<int32_t>(i % 1440);
+            flights.push_back(FlightFactory::create_flight(FlightType::Domestic, "BL" + to_string(i), "Bench Origin", "Bench Destination",
+                                                           departure, departure + 90));
+        }
+        schedule.add_flights(flights);
+        vector<string> numbers(lookup_count);
+        for (auto& number : numbers) {
+            number = "BL" + to_string(rng() % flight_count);
+        }
+
+        size_t found = 0;
+        auto started = chrono::steady_clock::now();
+        for (const auto& number : numbers) {
+            found += schedule.find_flight(number) != nullptr;
+        }
+        double index_ns = nanoseconds_since(started) / numbers.size();
+
+        // The scan costs O(flights) per lookup, so it gets a smaller share of the lookups at larger sizes
+        size_t scan_count = max<size_t>(20, min(lookup_count, 20000000 / flight_count));
+        started = chrono::steady_clock::now();
+        for (size_t i = 0; i < scan_count; ++i) {
+            vector<Flight*> copy = schedule.get_flights();
+            for (auto* flight : copy) {
+                if (flight->get_flight_number() == numbers[i]) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        double scan_ns = nanoseconds_since(started) / scan_count;
+        if (found != lookup_count + scan_count) {
+            cout << "FAILED: " << lookup_count + scan_count - found << " lookups missed a scheduled flight" << endl;
+            return 1;
+        }
+        cout << setw(10) << flight_count << setw(16) << fixed << setprecision(1) << index_ns << setw(16) << scan_ns
+            << setw(11) << setprecision(0) << scan_ns / index_ns << "x" << defaultfloat << endl;
+
+        for (auto* flight : flights) {
+            FlightFactory::destroy_flight(flight);
+        }
+    }
+    return 0;
+}
+
+// Journey planner benchmark. Generates a seeded synthetic day of legs between random airports, builds a planner
+// over it and times random earliest-arrival queries with up to two connections of at least 30 minutes.
+int run_bench_journey(size_t leg_count, size_t query_count) {
+    const size_t airport_count = 400;
+    const int32_t day_start = 19523 * 1440; // 2023-06-15
+    mt19937 rng(1);
+    vector<string> airports(airport_count);
+    for (size_t a = 0; a < airport_count; ++a) {
+        airports[a] = "Airport " + to_string(a);
+    }
+    vector<string> numbers(leg_count);
+    vector<ScheduleLeg> legs(leg_count);
+    for (size_t i = 0; i < leg_count; ++i) {
+        numbers[i] = "JB" + to_string(i);
+        size_t from = rng() % airport_count;
+        size_t to = (from + 1 + rng() % (airport_count - 1)) % airport_count;
+        int32_t departure = day_start + static_cast<int32_t>(rng() % 1440);
+        legs[i] = ScheduleLeg{ nullptr, numbers[i], airports[from], airports[to], departure,
+                               departure + 45 + static_cast<int32_t>(rng() % 300), FlightType::Domestic };
+    }
+    sort(legs.begin(), legs.end(), [](const ScheduleLeg& a, const ScheduleLeg& b) { return a.departure_minutes < b.departure_minutes; });
+
+    auto started = chrono::steady_clock::now();
+    JourneyPlanner planner(legs);
+    double build_ms = nanoseconds_since(started) / 1e6;
+
+    vector<uint64_t> latencies;
+    latencies.reserve(query_count);
+    size_t found = 0;
+    for (size_t q = 0; q < query_count; ++q) {
+        const string& origin = airports[rng() % airport_count];
+        const string& destination = airports[rng() % airport_count];
+        int32_t depart_after = day_start + static_cast<int32_t>(rng() % 720);
+        started = chrono::steady_clock::now();
+        Journey journey = planner.earliest_arrival(origin, destination, depart_after, 2, 30);
+        latencies.push_back(static_cast<uint64_t>(nanoseconds_since(started)));
+        found += journey.found();
+    }
+    sort(latencies.begin(), latencies.end());
+    cout << "Legs: " << leg_count << ", Airports: " << airport_count << ", Planner build: " << build_ms << " ms" << endl;
+    cout << "Queries: " << query_count << ", Journeys found: " << found << endl;
+    cout << right << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "max us" << endl;
+    cout << setw(10) << percentile_us(latencies, 0.5) << setw(10) << percentile_us(latencies, 0.9) << setw(10)
+        << percentile_us(latencies, 0.99) << setw(10) << latencies.back() / 1000.0 << endl;
+    return 0;
+}
 
-    string new_info;
-    switch (choice) {
-    case 1:
-        cout << "Enter new email: ";
-        cin >> new_info;
-        passenger->set_email(new_info);
-        break;
-    case 2:
-        cout << "Enter new phone number: ";
-        cin >> new_info;
-        passenger->set_phone_number(new_info);
-        break;
-    default:
-        cout << "Invalid choice" << endl;
+// Best wall time, in milliseconds, of several runs of a function
+template <typename Function>
+double best_of_ms(int runs, Function function) {
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run) {
+        auto started = chrono::steady_clock::now();
+        function();
+        best = min(best, nanoseconds_since(started) / 1e6);
     }
+    return best;
 }
 
-// Function to add a new passenger
-Passenger* add_passenger() {
-    string name, email, phone_number, passport_number;
-    cout << "Enter passenger details:" << endl;
-    cout << "Name: ";
-    cin >> ws;
-    getline(cin, name);
-    cout << "Email: ";
-    getline(cin, email);
-    cout << "Phone Number: ";
-    getline(cin, phone_number);
-    cout << "Passport Number: ";
-    getline(cin, passport_number);
-    return new Passenger(name, email, phone_number, passport_number);
+// FlightTable benchmark. Creates a million flights of random kinds between 50 airports and filters them by
+// type and by route twice: as objects, testing each with dynamic_cast or comparing its airports through the
+// pointer, and as FlightTable columns. Both sides compare interned airport IDs, so the difference is layout.
+int run_bench_table(size_t flight_count) {
+    const size_t airport_count = 50;
+    const int runs = 5;
+    mt19937 rng(1);
+    vector<Symbol> airports(airport_count);
+    for (size_t a = 0; a < airport_count; ++a) {
+        airports[a] = SymbolTable::instance().intern("Table Airport " + to_string(a));
+    }
+    vector<Flight*> flights;
+    flights.reserve(flight_count);
+    for (size_t i = 0; i < flight_count; ++i) {
+        size_t from = rng() % airport_count;
+        size_t to = (from + 1 + rng() % (airport_count - 1)) % airport_count;
+        int32_t departure = 19523 * 1440 + static_cast<int32_t>(rng() % 1440);
+        flights.push_back(FlightFactory::create_flight(rng() % 2 ? FlightType::Domestic : FlightType::International, "TB" + to_string(i),
+            SymbolTable::instance().name(airports[from]), SymbolTable::instance().name(airports[to]), departure, departure + 120));
+    }
+    FlightTable table;
+    table.reserve(flight_count);
+    for (auto* flight : flights) {
+        table.add_flight(flight->get_flight_type(), flight->get_flight_number_id(), flight->get_origin_id(), flight->get_destination_id(),
+                         flight->get_departure_minutes(), flight->get_arrival_minutes(), 0.0);
+    }
+    Symbol origin = airports[0], destination = airports[1];
+
+    size_t object_domestic = 0, object_route = 0, table_domestic = 0, table_route = 0;
+    double object_type_ms = best_of_ms(runs, [&]() {
+        vector<DomesticFlight*> selected;
+        for (auto* flight : flights) {
+            if (auto* domestic = dynamic_cast<DomesticFlight*>(flight)) {
+                selected.push_back(domestic);
+            }
+        }
+        object_domestic = selected.size();
+    });
+    double table_type_ms = best_of_ms(runs, [&]() { table_domestic = table.select_by_type(FlightType::Domestic).size(); });
+    double object_route_ms = best_of_ms(runs, [&]() {
+        vector<Flight*> selected;
+        for (auto* flight : flights) {
+            if (flight->get_origin_id() == origin && flight->get_destination_id() == destination) {
+                selected.push_back(flight);
+            }
+        }
+        object_route = selected.size();
+    });
+    double table_route_ms = best_of_ms(runs, [&]() { table_route = table.select_by_route(origin, destination).size(); });
+
+    for (auto* flight : flights) {
+        FlightFactory::destroy_flight(flight);
+    }
+    cout << "Flights: " << flight_count << ", best of " << runs << " runs" << endl;
+    cout << left << setw(16) << "Filter" << right << setw(10) << "Matches" << setw(14) << "Objects ms" << setw(12) << "Table ms"
+        << setw(10) << "Speedup" << endl << fixed << setprecision(2);
+    cout << left << setw(16) << "Domestic" << right << setw(10) << table_domestic << setw(14) << object_type_ms << setw(12) << table_type_ms
+        << setw(9) << object_type_ms / table_type_ms << "x" << endl;
+    cout << left << setw(16) << "One route" << right << setw(10) << table_route << setw(14) << object_route_ms << setw(12) << table_route_ms
+        << setw(9) << object_route_ms / table_route_ms << "x" << endl << defaultfloat;
+    if (object_domestic != table_domestic || object_route != table_route) {
+        cout << "FAILED: the table and the objects selected different flights" << endl;
+        return 1;
+    }
+    return 0;
 }
 
-// Function to book a new flight for a passenger
-Booking* book_flight(Passenger* passenger, Schedule& schedule) {
-    string flight_number, seat_number, booking_id;
-    cout << "Enter flight number: ";
-    cin >> flight_number;
-    try {
-        Flight* flight = find_flight_by_number(schedule, flight_number);
-        cout << "Enter seat number: ";
-        cin >> seat_number;
-        cout << "Enter booking ID: ";
-        cin >> booking_id;
-        Booking* new_booking = new Booking(booking_id, passenger, flight, seat_number, "Pending");
-        flight->attach(passenger);
-        return new_booking;
-    } catch (const FlightNotFoundException& e) {
-        cout << e.what() << endl;
-        return nullptr;
+// Write text to a file, returning false on failure
+bool write_text_file(const string& path, const string& text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
     }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && written;
 }
 
-// Function to view a specific passenger's details
-void view_passenger_details(const vector<Passenger*>& passengers) {
-    string passport_number;
-    cout << "Enter passport number: ";
-    cin >> passport_number;
-    for (const auto& passenger : passengers) {
-        if (passenger->get_passport_number() == passport_number) {
-            passenger->get_passenger_info();
-            return;
+// Snapshot benchmark. Builds a state of flights over ten days, passengers and one booking per passenger, then
+// saves it both as a snapshot and as CSV files (flights and passengers in the import formats, bookings as
+// booking_id,passport_number,flight_number,departure_date,seat_number,status). Reports file sizes, the time to
+// map and validate the snapshot, and the time to load each into a fresh system. The files are written with the
+// given path prefix and removed afterwards.
+int run_bench_snapshot(size_t flight_count, size_t passenger_count, const string& prefix) {
+    const int32_t first_day = 19523; // 2023-06-15
+    mt19937 rng(1);
+    PassengerRegistry passengers;
+    BookingStore bookings;
+    vector<Itinerary*> itineraries;
+    ScheduleCalendar* calendar = new ScheduleCalendar("BENCH");
+    vector<Flight*> flights;
+    for (size_t i = 0; i < flight_count; ++i) {
+        int32_t departure = (first_day + static_cast<int32_t>(i % 10)) * 1440 + static_cast<int32_t>(rng() % 1200);
+        flights.push_back(FlightFactory::create_flight(rng() % 4 ? FlightType::Domestic : FlightType::International, "SB" + to_string(i),
+            "Airport " + to_string(rng() % 200), "Airport " + to_string(rng() % 200), departure, departure + 60 + static_cast<int32_t>(rng() % 600)));
+    }
+    calendar->add_flights(flights);
+    vector<PassengerHandle> handles;
+    for (size_t i = 0; i < passenger_count; ++i) {
+        handles.push_back(passengers.add_passenger("Passenger " + to_string(i), "passenger" + to_string(i) + "@example.com",
+                                                   to_string(5550000000 + i), "SP" + to_string(i)));
+    }
+    for (size_t i = 0; i < passenger_count; ++i) {
+        Flight* flight = flights[rng() % flights.size()];
+        if (flight->check_availability()) {
+            bookings.create_booking("SBK" + to_string(i), passengers, handles[i], flight,
+                flight->get_seat_map().seat_label(flight->get_seat_map().next_free_seat()), static_cast<BookingStatus>(rng() % 2));
         }
     }
-    cout << "Passenger not found" << endl;
+
+    string snapshot_path = prefix + ".snap";
+    string flights_path = prefix + "-flights.csv", passengers_path = prefix + "-passengers.csv", bookings_path = prefix + "-bookings.csv";
+    auto started = chrono::steady_clock::now();
+    write_snapshot(snapshot_path, *calendar, passengers, bookings, itineraries);
+    double snapshot_write_ms = nanoseconds_since(started) / 1e6;
+
+    started = chrono::steady_clock::now();
+    string text = "type,flight_number,origin,destination,departure_time,arrival_time\n";
+    for (auto* flight : flights) {
+        text += flight_type_name(flight->get_flight_type());
+        text += ',' + flight->get_flight_number() + ',' + flight->get_origin() + ',' + flight->get_destination() + ',' +
+                format_timestamp(flight->get_departure_minutes()) + ',' + format_timestamp(flight->get_arrival_minutes()) + '\n';
+    }
+    bool csv_written = write_text_file(flights_path, text);
+    text = "name,email,phone_number,passport_number\n";
+    for (size_t i = 0; i < passengers.size(); ++i) {
+        const Passenger& passenger = passengers.get(handles[i]);
+        text += passenger.get_name() + ',' + passenger.get_email() + ',' + passenger.get_phone_number() + ',' + passenger.get_passport_number() + '\n';
+    }
+    csv_written = write_text_file(passengers_path, text) && csv_written;
+    text = "booking_id,passport_number,flight_number,departure_date,seat_number,status\n";
+    for (size_t i = 0; i < bookings.size(); ++i) {
+        const Booking* booking = bookings.at(i);
+        const Flight* flight = booking->get_flight();
+        text += booking->get_booking_id() + ',' + booking->get_passenger()->get_passport_number() + ',' + flight->get_flight_number() + ',' +
+                format_date(day_of(flight->get_departure_minutes())) + ',' + booking->get_seat_number() + ',' +
+                to_string(static_cast<int>(booking->get_booking_status())) + '\n';
+    }
+    csv_written = write_text_file(bookings_path, text) && csv_written;
+    double csv_write_ms = nanoseconds_since(started) / 1e6;
+    size_t booking_count = bookings.size();
+    bookings.clear();
+    delete calendar;
+
+    auto file_size = [](const string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? static_cast<size_t>(info.st_size) : size_t(0);
+    };
+    size_t snapshot_bytes = file_size(snapshot_path);
+    size_t csv_bytes = file_size(flights_path) + file_size(passengers_path) + file_size(bookings_path);
+
+    // Map and validate only: what a reader of the records in place pays
+    started = chrono::steady_clock::now();
+    double map_ms;
+    {
+        SnapshotView view(snapshot_path);
+        map_ms = nanoseconds_since(started) / 1e6;
+    }
+
+    // Full load of the snapshot into a fresh system
+    size_t snapshot_bookings;
+    double snapshot_load_ms;
+    {
+        PassengerRegistry loaded_passengers;
+        BookingStore loaded_bookings;
+        vector<Itinerary*> loaded_itineraries;
+        started = chrono::steady_clock::now();
+        SnapshotView view(snapshot_path);
+        ScheduleCalendar* loaded = load_snapshot(view, loaded_passengers, loaded_bookings, loaded_itineraries);
+        snapshot_load_ms = nanoseconds_since(started) / 1e6;
+        snapshot_bookings = loaded_bookings.size();
+        loaded_bookings.clear();
+        delete loaded;
+    }
+
+    // Full load of the CSV files into a fresh system, through the importers and a booking parser
+    size_t csv_bookings = 0;
+    double csv_load_ms;
+    {
+        PassengerRegistry loaded_passengers;
+        BookingStore loaded_bookings;
+        ScheduleCalendar* loaded = new ScheduleCalendar("CSV");
+        ImportResult result;
+        started = chrono::steady_clock::now();
+        bool imported = import_flights_csv(flights_path, *loaded, result) && import_passengers_csv(passengers_path, loaded_passengers, result);
+        MappedFile file;
+        if (imported && file.open(bookings_path)) {
+            string_view data = skip_csv_header(string_view(file.data(), file.size()), "booking_id");
+            while (!data.empty()) {
+                size_t newline = data.find('\n');
+                string_view line = data.substr(0, newline);
+                data.remove_prefix(newline == string_view::npos ? data.size() : newline + 1);
+                string_view fields[6];
+                int32_t day;
+                if (!split_csv_line(line, fields, 6) || !parse_date(fields[3], day)) {
+                    continue;
+                }
+                PassengerHandle passenger = loaded_passengers.find(fields[1]);
+                Flight* flight = loaded->find_flight(fields[2], day);
+                if (passenger.is_valid() && flight &&
+                    loaded_bookings.create_booking(string(fields[0]), loaded_passengers, passenger, flight, string(fields[4]),
+                                                   static_cast<BookingStatus>(fields[5][0] - '0')).is_valid()) {
+                    ++csv_bookings;
+                }
+            }
+        }
+        csv_load_ms = nanoseconds_since(started) / 1e6;
+        loaded_bookings.clear();
+        delete loaded;
+    }
+    for (const auto& path : { snapshot_path, flights_path, passengers_path, bookings_path }) {
+        remove(path.c_str());
+    }
+
+    cout << "Flights: " << flight_count << ", Passengers: " << passenger_count << ", Bookings: " << booking_count << endl;
+    cout << left << setw(10) << "Format" << right << setw(14) << "Size MB" << setw(12) << "Write ms" << setw(12) << "Map ms"
+        << setw(12) << "Load ms" << endl << fixed << setprecision(1);
+    cout << left << setw(10) << "Snapshot" << right << setw(14) << snapshot_bytes / 1e6 << setw(12) << snapshot_write_ms << setw(12) << map_ms
+        << setw(12) << snapshot_load_ms << endl;
+    cout << left << setw(10) << "CSV" << right << setw(14) << csv_bytes / 1e6 << setw(12) << csv_write_ms << setw(12) << "-"
+        << setw(12) << csv_load_ms << endl << defaultfloat;
+    if (!csv_written || snapshot_bookings != booking_count || csv_bookings != booking_count) {
+        cout << "FAILED: a format did not restore every booking" << endl;
+        return 1;
+    }
+    return 0;
 }
 
-// Function to view flight details
-void view_flight_details(const vector<Flight*>& flights) {
-    string flight_number;
-    cout << "Enter flight number: ";
-    cin >> flight_number;
-    for (const auto& flight : flights) {
-        if (flight->get_flight_number() == flight_number) {
-            flight->get_flight_info();
-            return;
+// Journal benchmark. For each thread count, threads book seats for the given seconds the way the request server
+// does: each creates and confirms a booking under a shared state lock inside a DeferredCommits scope, releases the
+// lock and waits for durability. This runs once with every record synced on its own and once with group commit.
+// Prints bookings per second, latency percentiles and records per sync. The journal is written to the given path
+// and removed afterwards.
+int run_bench_journal(size_t max_threads, int seconds, const string& path) {
+    BookingJournal& journal = BookingJournal::instance();
+    cout << left << setw(14) << "Mode" << right << setw(8) << "Threads" << setw(12) << "Bookings" << setw(12) << "Bookings/s"
+        << setw(14) << "Records/sync" << setw(10) << "p50 us" << setw(10) << "p99 us" << endl;
+    for (bool group_commit : { false, true }) {
+        for (size_t thread_count : bench_thread_counts(max_threads)) {
+            if (!journal.open(path, 0, group_commit)) {
+                cout << "Cannot open journal: " << path << endl;
+                return 1;
+            }
+            PassengerRegistry passengers;
+            BookingStore bookings;
+            vector<Flight*> flights;
+            mutex state_mutex;
+            vector<PassengerHandle> travellers;
+            for (size_t t = 0; t < thread_count; ++t) {
+                travellers.push_back(passengers.add_passenger("Journal Bench", "bench@example.com", "0", "JBP" + to_string(t)));
+            }
+            vector<vector<uint64_t>> latencies(thread_count);
+            atomic<size_t> next_booking(0);
+            auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+            vector<thread> threads;
+            for (size_t t = 0; t < thread_count; ++t) {
+                threads.emplace_back([&, t]() {
+                    while (chrono::steady_clock::now() < deadline) {
+                        auto started = chrono::steady_clock::now();
+                        BookingJournal::DeferredCommits commits;
+                        {
+                            lock_guard<mutex> lock(state_mutex);
+                            if (flights.empty() || !flights.back()->check_availability()) {
+                                int32_t departure = 19523 * 1440 + static_cast<int32_t>(flights.size() % 1440);
+                                flights.push_back(FlightFactory::create_flight(FlightType::Domestic, "JB" + to_string(flights.size()),
+                                                                               "Bench Origin", "Bench Destination", departure, departure + 90));
+                            }
+                            Flight* flight = flights.back();
+                            string seat_number = flight->get_seat_map().seat_label(flight->get_seat_map().next_free_seat());
+                            Booking* booking = bookings.get(bookings.create_booking("JBK" + to_string(next_booking++), passengers,
+                                                                                    travellers[t], flight, seat_number, BookingStatus::Pending));
+                            booking->confirm_booking();
+                        }
+                        commits.wait();
+                        latencies[t].push_back(static_cast<uint64_t>(nanoseconds_since(started)));
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            uint64_t records = journal.get_record_count(), syncs = journal.get_sync_count();
+            journal.close();
+            bookings.clear();
+            for (auto* flight : flights) {
+                FlightFactory::destroy_flight(flight);
+            }
+
+            vector<uint64_t> merged;
+            for (const auto& thread_latencies : latencies) {
+                merged.insert(merged.end(), thread_latencies.begin(), thread_latencies.end());
+            }
+            sort(merged.begin(), merged.end());
+            cout << left << setw(14) << (group_commit ? "Group commit" : "Sync per event") << right << setw(8) << thread_count
+                << setw(12) << merged.size() << setw(12) << static_cast<uint64_t>(merged.size() / static_cast<double>(seconds))
+                << setw(14) << (syncs ? static_cast<double>(records) / syncs : 0.0) << setw(10) << percentile_us(merged, 0.5)
+                << setw(10) << percentile_us(merged, 0.99) << endl;
         }
     }
-    cout << "Flight not found" << endl;
+    remove(path.c_str());
+    return 0;
 }
 
-int main() {
-    // Creating initial passengers
-    Passenger* passenger1 = new Passenger("John Doe", "john@example.com", "1234567890", "P12345");
-    Passenger* passenger2 = new Passenger("Jane Smith", "jane@example.com", "0987654321", "P54321");
+// Fare benchmark. Creates flights of random kinds, lengths and loads, then prices all of them under rules with
+// an hourly rate and load-factor and advance-purchase bands: once with FareEngine::reprice over FlightTable
+// columns and once with a FareEngine::quote per flight. Reports the best of several runs per thousand flights
+// and fails if the two disagree on any fare.
+int run_bench_fares(size_t flight_count) {
+    const int runs = 5;
+    const int32_t purchase_minutes = 19500 * 1440;
+    mt19937 rng(1);
+    vector<Flight*> flights;
+    flights.reserve(flight_count);
+    FlightTable table;
+    table.reserve(flight_count);
+    for (size_t i = 0; i < flight_count; ++i) {
+        int32_t departure = (19523 + static_cast<int32_t>(rng() % 60)) * 1440 + static_cast<int32_t>(rng() % 1440);
+        Flight* flight = FlightFactory::create_flight(rng() % 2 ? FlightType::Domestic : FlightType::International, "FB" + to_string(i),
+                                                      "Fare Origin", "Fare Destination", departure, departure + 45 + static_cast<int32_t>(rng() % 700));
+        for (uint32_t seat = rng() % 150; seat > 0; --seat) {
+            flight->get_seat_map().claim_next_free_seat();
+        }
+        flights.push_back(flight);
+        const SeatMap& seats = flight->get_seat_map();
+        table.add_flight(flight->get_flight_type(), flight->get_flight_number_id(), flight->get_origin_id(), flight->get_destination_id(),
+                         flight->get_departure_minutes(), flight->get_arrival_minutes(),
+                         static_cast<double>(seats.get_occupied_seats()) / seats.get_total_seats());
+    }
+    FareRules rules;
+    rules.hourly_rate = 35.0;
+    rules.cabin_multipliers[static_cast<size_t>(CabinClass::Business)] = 2.5;
+    double load_thresholds[] = { 0.5, 0.7, 0.85, 0.95 }, load_multipliers[] = { 1.1, 1.25, 1.5, 2.0 };
+    double advance_days[] = { 30, 14, 7, 1 }, advance_multipliers[] = { 1.05, 1.2, 1.4, 1.8 };
+    copy(begin(load_thresholds), end(load_thresholds), rules.load_thresholds);
+    copy(begin(load_multipliers), end(load_multipliers), rules.load_multipliers);
+    copy(begin(advance_days), end(advance_days), rules.advance_days);
+    copy(begin(advance_multipliers), end(advance_multipliers), rules.advance_multipliers);
+    FareEngine engine(rules);
 
-    // Creating initial flights
-    Flight* flight1 = FlightFactory::create_flight("Domestic", "FL123", "New York", "Los Angeles", "2023-06-15 10:00", "2023-06-15 14:00");
-    Flight* flight2 = FlightFactory::create_flight("International", "FL456", "New York", "London", "2023-06-16 18:00", "2023-06-17 06:00");
+    double reprice_ms = best_of_ms(runs, [&]() { engine.reprice(table, CabinClass::Economy, purchase_minutes); });
+    vector<double> quotes(flight_count);
+    double quote_ms = best_of_ms(runs, [&]() {
+        for (size_t i = 0; i < flight_count; ++i) {
+            quotes[i] = engine.quote(ScheduleLeg::of(flights[i]), CabinClass::Economy, purchase_minutes);
+        }
+    });
+    size_t disagreements = 0;
+    for (size_t i = 0; i < flight_count; ++i) {
+        disagreements += fabs(quotes[i] - table.get_fare(static_cast<uint32_t>(i))) > 1e-9 * quotes[i];
+    }
+    for (auto* flight : flights) {
+        FlightFactory::destroy_flight(flight);
+    }
 
-    // Creating initial bookings
-    Booking* booking1 = new Booking("B123", passenger1, flight1, "12A", "Confirmed");
-    Booking* booking2 = new Booking("B456", passenger2, flight2, "14B", "Confirmed");
+    double thousands = flight_count / 1000.0;
+    cout << "Flights: " << flight_count << ", best of " << runs << " runs" << endl;
+    cout << left << setw(18) << "Method" << right << setw(12) << "Total ms" << setw(20) << "us per 1000 flights" << endl << fixed << setprecision(2);
+    cout << left << setw(18) << "Batch reprice" << right << setw(12) << reprice_ms << setw(20) << reprice_ms * 1000 / thousands << endl;
+    cout << left << setw(18) << "Per-flight quote" << right << setw(12) << quote_ms << setw(20) << quote_ms * 1000 / thousands << endl << defaultfloat;
+    if (disagreements) {
+        cout << "FAILED: " << disagreements << " fares differ between the batch and the quotes" << endl;
+        return 1;
+    }
+    return 0;
+}
 
-    // Attach passengers to flights as observers
-    flight1->attach(passenger1);
-    flight2->attach(passenger2);
+// Flight kind benchmark. Schedules flights of random kinds and loads, then totals the fare of the sold seats
+// and counts the flights still selling, three ways: dynamic_cast on each flight of a mixed list, virtual calls
+// on each flight of a mixed list, and a pass over each of the schedule's per-kind lists. Reports the best of
+// several runs per million flights and fails if the methods disagree.
+int run_bench_kinds(size_t flight_count) {
+    const int runs = 5;
+    mt19937 rng(1);
+    vector<Flight*> flights;
+    flights.reserve(flight_count);
+    for (size_t i = 0; i < flight_count; ++i) {
+        int32_t departure = 19523 * 1440 + static_cast<int32_t>(rng() % 1440);
+        Flight* flight = FlightFactory::create_flight(rng() % 2 ? FlightType::Domestic : FlightType::International, "FK" + to_string(i),
+                                                      "Kind Origin", "Kind Destination", departure, departure + 90);
+        // Leave a few flights full so availability varies
+        size_t seats = rng() % 8 ? rng() % 40 : flight->get_seat_map().get_total_seats();
+        for (size_t seat = 0; seat < seats; ++seat) {
+            flight->get_seat_map().claim_next_free_seat();
+        }
+        flights.push_back(flight);
+    }
+    Schedule schedule("BENCH", "2023-06-15");
+    schedule.add_flights(flights);
 
-    // Creating itinerary
-    Itinerary* itinerary = new Itinerary("I123");
-    itinerary->add_booking(booking1);
-    itinerary->add_booking(booking2);
+    struct Totals {
+        double revenue;
+        size_t available;
+    };
+    Totals by_cast{}, by_virtual{}, by_kind{};
+    double cast_ms = best_of_ms(runs, [&]() {
+        Totals totals{};
+        for (auto* flight : flights) {
+            if (auto* domestic = dynamic_cast<DomesticFlight*>(flight)) {
+                totals.revenue += domestic->get_base_fare() * domestic->get_seat_map().get_occupied_seats();
+                totals.available += domestic->check_availability();
+            } else if (auto* international = dynamic_cast<InternationalFlight*>(flight)) {
+                totals.revenue += international->get_base_fare() * international->get_seat_map().get_occupied_seats();
+                totals.available += international->check_availability();
+            }
+        }
+        by_cast = totals;
+    });
+    double virtual_ms = best_of_ms(runs, [&]() {
+        Totals totals{};
+        for (auto* flight : flights) {
+            totals.revenue += flight->get_base_fare() * flight->get_seat_map().get_occupied_seats();
+            totals.available += flight->check_availability();
+        }
+        by_virtual = totals;
+    });
+    double kind_ms = best_of_ms(runs, [&]() {
+        Totals totals{};
+        auto add_kind = [&](const auto& kind_flights) {
+            for (auto* flight : kind_flights) {
+                totals.revenue += flight->get_base_fare() * flight->get_seat_map().get_occupied_seats();
+                totals.available += flight->check_availability();
+            }
+        };
+        add_kind(schedule.get_flights_of_kind<FlightType::Domestic>());
+        add_kind(schedule.get_flights_of_kind<FlightType::International>());
+        by_kind = totals;
+    });
+    for (auto* flight : flights) {
+        FlightFactory::destroy_flight(flight);
+    }
+
+    double millions = flight_count / 1000000.0;
+    cout << "Flights: " << flight_count << ", best of " << runs << " runs" << endl;
+    cout << left << setw(20) << "Method" << right << setw(12) << "Total ms" << setw(18) << "ms per 1M flights" << endl << fixed << setprecision(2);
+    cout << left << setw(20) << "dynamic_cast" << right << setw(12) << cast_ms << setw(18) << cast_ms / millions << endl;
+    cout << left << setw(20) << "Virtual calls" << right << setw(12) << virtual_ms << setw(18) << virtual_ms / millions << endl;
+    cout << left << setw(20) << "Per-kind lists" << right << setw(12) << kind_ms << setw(18) << kind_ms / millions << endl << defaultfloat;
+    bool agree = by_cast.available == by_virtual.available && by_cast.available == by_kind.available
+        && fabs(by_cast.revenue - by_virtual.revenue) <= 1e-9 * by_cast.revenue
+        && fabs(by_cast.revenue - by_kind.revenue) <= 1e-9 * by_cast.revenue;
+    if (!agree) {
+        cout << "FAILED: the methods disagree on revenue or availability" << endl;
+        return 1;
+    }
+    return 0;
+}
 
-    // Creating schedule
-    Schedule* schedule = new Schedule("S123", "2023-06-15");
-    schedule->add_flight(flight1);
-    schedule->add_flight(flight2);
+// Report benchmark. Books the given number of flights about two-thirds full, then renders every flight's
+// manifest with render_report on pools of 1 up to the given number of threads. Reports the best of several
+// runs, manifests per second and the speedup over one thread, and fails if any report differs from the
+// one-thread report.
+int run_bench_reports(size_t max_threads, size_t flight_count) {
+    const int runs = 5;
+    mt19937 rng(1);
+    PassengerRegistry passengers;
+    vector<PassengerHandle> handles;
+    for (size_t i = 0; i < 10000; ++i) {
+        string number = to_string(i);
+        handles.push_back(passengers.add_passenger("Passenger " + number, "passenger" + number + "@example.com", "555-" + number, "RP" + number));
+    }
+    vector<Flight*> flights;
+    BookingStore bookings;
+    size_t booking_count = 0;
+    for (size_t i = 0; i < flight_count; ++i) {
+        int32_t departure = 19523 * 1440 + static_cast<int32_t>(rng() % 1440);
+        Flight* flight = FlightFactory::create_flight(rng() % 2 ? FlightType::Domestic : FlightType::International, "FR" + to_string(i),
+                                                      "Report Origin", "Report Destination", departure, departure + 120);
+        flights.push_back(flight);
+        for (const auto& cabin : flight->get_seat_map().get_cabins()) {
+            for (int row = cabin.first_row; row < cabin.first_row + cabin.row_count; ++row) {
+                for (char letter : cabin.seat_letters) {
+                    if (rng() % 3) {
+                        bookings.create_booking("RB" + to_string(booking_count++), passengers, handles[rng() % handles.size()], flight,
+                                                to_string(row) + letter, static_cast<BookingStatus>(rng() % 3));
+                    }
+                }
+            }
+        }
+    }
+    auto render = [&flights](size_t i, string& out) { append_manifest(flights[i], out); };
+    string expected;
+    bool mismatch = false;
+
+    cout << "Flights: " << flight_count << ", bookings: " << booking_count << ", best of " << runs << " runs" << endl << fixed;
+    cout << right << setw(8) << "Threads" << setw(12) << "ms" << setw(16) << "Manifests/s" << setw(10) << "Speedup" << endl;
+    double single_ms = 0;
+    for (size_t thread_count : bench_thread_counts(max_threads)) {
+        WorkStealingPool pool(thread_count);
+        string report;
+        double ms = best_of_ms(runs, [&]() { report = render_report(flights.size(), render, pool); });
+        // bench_thread_counts starts at one thread, whose report the others must reproduce
+        if (thread_count == 1) {
+            single_ms = ms;
+            expected = move(report);
+        } else {
+            mismatch |= report != expected;
+        }
+        cout << setw(8) << thread_count << setw(12) << setprecision(2) << ms << setw(16) << setprecision(0) << flight_count / (ms / 1000)
+            << setw(10) << setprecision(2) << single_ms / ms << endl;
+    }
+    cout << "Report: " << setprecision(1) << expected.size() / 1e6 << " MB" << endl << defaultfloat;
+
+    bookings.clear();
+    for (auto* flight : flights) {
+        BookingLedger::instance().forget_flight(*flight);
+        FlightFactory::destroy_flight(flight);
+    }
+    if (mismatch) {
+        cout << "FAILED: a report differed from the one-thread report" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Instrumentation benchmark. Times the probed hot paths in batches (finding flights by number, then booking,
+// confirming and cancelling every seat of a schedule) and reports the best mean per operation over several
+// rounds, then dumps the probes. Run it once in the default build and once with
+// -DFLIGHT_SYSTEM_INSTRUMENTATION=1; the difference between the two is the probes' cost.
+int run_bench_instrumentation(size_t flight_count) {
+    const int rounds = 5;
+    const size_t lookups = 2000000;
+    PassengerRegistry passengers;
+    vector<PassengerHandle> handles;
+    for (size_t i = 0; i < 1000; ++i) {
+        string number = to_string(i);
+        handles.push_back(passengers.add_passenger("Passenger " + number, "passenger" + number + "@example.com", "555-" + number, "IP" + number));
+    }
+    Schedule schedule("BENCH", "2023-06-15");
+    vector<string> numbers;
+    for (size_t i = 0; i < flight_count; ++i) {
+        numbers.push_back("FI" + to_string(i));
+        int32_t departure = 19523 * 1440 + static_cast<int32_t>(i % 1440);
+        schedule.add_flight(FlightFactory::create_flight(FlightType::Domestic, numbers.back(), "Probe Origin", "Probe Destination",
+                                                         departure, departure + 90));
+    }
+    // Every seat of every flight, with the booking ID that takes it
+    struct Seat {
+        Flight* flight;
+        string label;
+        string booking_id;
+    };
+    vector<Seat> seats;
+    for (auto* flight : schedule.get_flights()) {
+        for (const auto& cabin : flight->get_seat_map().get_cabins()) {
+            for (int row = cabin.first_row; row < cabin.first_row + cabin.row_count; ++row) {
+                for (char letter : cabin.seat_letters) {
+                    seats.push_back(Seat{ flight, to_string(row) + letter, "IB" + to_string(seats.size()) });
+                }
+            }
+        }
+    }
+
+    BookingStore bookings;
+    vector<BookingHandle> booked(seats.size());
+    double find_ns = 0, create_ns = 0, confirm_ns = 0, cancel_ns = 0;
+    size_t found = 0;
+    auto keep_best = [](double& best, double ns) { best = best == 0 ? ns : min(best, ns); };
+    for (int round = 0; round < rounds; ++round) {
+        auto started = chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; ++i) {
+            found += schedule.find_flight(numbers[i % numbers.size()]) != nullptr;
+        }
+        keep_best(find_ns, nanoseconds_since(started) / lookups);
+
+        started = chrono::steady_clock::now();
+        for (size_t i = 0; i < seats.size(); ++i) {
+            booked[i] = bookings.create_booking(seats[i].booking_id, passengers, handles[i % handles.size()], seats[i].flight,
+                                                seats[i].label, BookingStatus::Pending);
+        }
+        keep_best(create_ns, nanoseconds_since(started) / seats.size());
+
+        started = chrono::steady_clock::now();
+        for (BookingHandle handle : booked) {
+            bookings.get(handle)->confirm_booking();
+        }
+        keep_best(confirm_ns, nanoseconds_since(started) / seats.size());
+
+        started = chrono::steady_clock::now();
+        for (const auto& seat : seats) {
+            cancel_booking(bookings, seat.booking_id);
+        }
+        keep_best(cancel_ns, nanoseconds_since(started) / seats.size());
+    }
+    bool consistent = found == lookups * rounds && bookings.size() == 0;
+    for (auto* flight : schedule.get_flights()) {
+        consistent &= flight->get_seat_map().get_occupied_seats() == 0;
+        BookingLedger::instance().forget_flight(*flight);
+        FlightFactory::destroy_flight(flight);
+    }
+
+    cout << "Instrumentation: " << (FLIGHT_SYSTEM_INSTRUMENTATION ? "compiled in" : "compiled out") << "; flights: " << flight_count
+        << ", bookings per round: " << seats.size() << ", best of " << rounds << " rounds" << endl;
+    cout << left << setw(16) << "Operation" << right << setw(10) << "ns/op" << endl << fixed << setprecision(1);
+    cout << left << setw(16) << "FindFlight" << right << setw(10) << find_ns << endl;
+    cout << left << setw(16) << "CreateBooking" << right << setw(10) << create_ns << endl;
+    cout << left << setw(16) << "ConfirmBooking" << right << setw(10) << confirm_ns << endl;
+    cout << left << setw(16) << "CancelBooking" << right << setw(10) << cancel_ns << endl << defaultfloat;
+    dump_instrumentation();
+    if (!consistent) {
+        cout << "FAILED: a lookup missed or a seat was left taken" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Booking engine benchmark. For each thread count, threads first race to sell every seat of a fresh flight,
+// which must sell exactly its capacity; then they keep a ring of holds each on one flight, cancelling the oldest
+// and reserving and confirming a new one, for the given seconds. The flight stays full, so most attempts contend
+// for the seat just released. Prints bookings per second and latency percentiles per attempt, and fails if sold
+// seats ever exceed capacity.
+int run_bench_booking(size_t max_threads, int seconds) {
+    const size_t ring_size = 64;
+    BookingEngine& engine = BookingEngine::instance();
+    bool oversold = false;
+
+    cout << right << setw(8) << "Threads" << setw(12) << "Sold" << setw(12) << "Bookings" << setw(14) << "Bookings/s"
+        << setw(12) << "Rejected" << setw(10) << "p50 us" << setw(10) << "p99 us" << setw(10) << "max us" << endl;
+    for (size_t thread_count : bench_thread_counts(max_threads)) {
+        Flight* flight = FlightFactory::create_flight(FlightType::Domestic, "BENCH1", "Bench Origin", "Bench Destination",
+                                                      "2023-06-15 10:00", "2023-06-15 12:00");
+        size_t capacity = flight->get_seat_map().get_total_seats();
+
+        // Oversell race: every thread claims seats until the flight is full
+        deque<Reservation> race(capacity * 2);
+        atomic<size_t> next_slot(0);
+        atomic<size_t> sold(0);
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&]() {
+                for (;;) {
+                    size_t slot = next_slot.fetch_add(1);
+                    if (slot >= race.size() || !engine.reserve_any(*flight, race[slot])) {
+                        return;
+                    }
+                    engine.confirm(race[slot]);
+                    sold.fetch_add(1);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        threads.clear();
+        size_t race_sold = sold.load();
+        if (race_sold != capacity || flight->get_seat_map().get_occupied_seats() != capacity) {
+            oversold = true;
+        }
+        for (auto& reservation : race) {
+            engine.cancel(reservation);
+        }
+
+        // Steady state: each thread cycles a ring of holds, keeping the flight full. sold counts a seat only
+        // after it is won and stops counting it before it is released, so it can never run ahead of the seats
+        // actually taken; the seat map's own counter briefly can, as a seat changes hands.
+        vector<vector<uint64_t>> latencies(thread_count);
+        vector<uint64_t> bookings(thread_count), rejections(thread_count);
+        atomic<bool> exceeded(false);
+        sold.store(0);
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t]() {
+                deque<Reservation> ring(ring_size);
+                for (size_t i = 0; chrono::steady_clock::now() < deadline; ++i) {
+                    Reservation& reservation = ring[i % ring_size];
+                    auto started = chrono::steady_clock::now();
+                    if (reservation.state.load() == Reservation::Confirmed) {
+                        sold.fetch_sub(1);
+                        engine.cancel(reservation);
+                    }
+                    if (engine.reserve_any(*flight, reservation)) {
+                        engine.confirm(reservation);
+                        ++bookings[t];
+                        if (sold.fetch_add(1) + 1 > capacity) {
+                            exceeded.store(true);
+                        }
+                    } else {
+                        ++rejections[t];
+                    }
+                    latencies[t].push_back(static_cast<uint64_t>(
+                        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count()));
+                }
+                for (auto& held : ring) {
+                    if (held.state.load() == Reservation::Confirmed) {
+                        sold.fetch_sub(1);
+                        engine.cancel(held);
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        if (exceeded.load() || flight->get_seat_map().get_occupied_seats() != 0) {
+            oversold = true;
+        }
+        FlightFactory::destroy_flight(flight);
 
-    vector<Booking*> bookings = { booking1, booking2 };
-    vector<Passenger*> passengers = { passenger1, passenger2 };
+        vector<uint64_t> merged;
+        uint64_t booked = 0, rejected = 0;
+        for (size_t t = 0; t < thread_count; ++t) {
+            merged.insert(merged.end(), latencies[t].begin(), latencies[t].end());
+            booked += bookings[t];
+            rejected += rejections[t];
+        }
+        sort(merged.begin(), merged.end());
+        cout << setw(8) << thread_count << setw(12) << race_sold << setw(12) << booked << setw(14)
+            << static_cast<uint64_t>(booked / static_cast<double>(seconds)) << setw(12) << rejected
+            << setw(10) << percentile_us(merged, 0.5) << setw(10) << percentile_us(merged, 0.99)
+            << setw(10) << (merged.empty() ? 0 : merged.back() / 1000.0) << endl;
+    }
+    if (oversold) {
+        cout << "FAILED: sold seats did not match the flight's capacity" << endl;
+        return 1;
+    }
+    cout << "Sold seats never exceeded capacity" << endl;
+    return 0;
+}
 
+// Function to run the interactive menu until the user exits
+void run_menu(ScheduleCalendar* calendar, PassengerRegistry& passengers, BookingStore& bookings, vector<Itinerary*>& itineraries,
+              Itinerary* itinerary, const string& snapshot_path) {
     int choice;
     do {
+        // Let pending notifications print before the menu does
+        NotificationDispatcher::instance().drain();
         cout << "Menu:" << endl;
         cout << "1. Display Itinerary" << endl;
         cout << "2. Display Schedule" << endl;
@@ -484,128 +7284,326 @@ int main() {
         cout << "8. Cancel Booking" << endl;
         cout << "9. View Specific Passenger's Details" << endl;
         cout << "10. View Flight Details" << endl;
-        cout << "11. Exit" << endl;
+        cout << "11. Plan Journey" << endl;
+        cout << "12. View Flights Departing in a Time Window" << endl;
+        cout << "13. Save Snapshot" << endl;
+        cout << "14. Import Flights from CSV" << endl;
+        cout << "15. Import Passengers from CSV" << endl;
+        cout << "16. Evict Days Before a Date" << endl;
+        cout << "17. Print Flight Manifests for a Date" << endl;
+        cout << "18. Dump Instrumentation" << endl;
+        cout << "19. Retime Flight" << endl;
+        cout << "20. Cancel Flight" << endl;
+        cout << "21. View Booking Totals for a Date" << endl;
+        cout << "22. Exit" << endl;
         cout << "Enter your choice: ";
         cin >> choice;
 
-        switch (choice) {
-        case 1:
-            itinerary->get_itinerary_details();
-            break;
-        case 2:
-            schedule->get_schedule_details();
-            break;
-        case 3:
-            display_passengers_by_flight_type(schedule->get_flights(), bookings);
-            break;
-        case 4:
-            {
-                string passport_number;
-                cout << "Enter passport number of the passenger to modify: ";
-                cin >> passport_number;
-                bool found = false;
-                for (auto* passenger : passengers) {
-                    if (passenger->get_passport_number() == passport_number) {
-                        modify_passenger_info(passenger);
-                        found = true;
-                        break;
+        try {
+            switch (choice) {
+            case 1:
+                itinerary->get_itinerary_details();
+                break;
+            case 2:
+                calendar->get_calendar_details();
+                break;
+            case 3:
+                display_passengers_by_flight_type(*calendar);
+                break;
+            case 4:
+                {
+                    string passport_number;
+                    cout << "Enter passport number of the passenger to modify: ";
+                    cin >> passport_number;
+                    PassengerHandle passenger = passengers.find(passport_number);
+                    if (passenger.is_valid()) {
+                        modify_passenger_info(&passengers.get(passenger));
+                    } else {
+                        cout << "Passenger not found" << endl;
                     }
                 }
-                if (!found) {
-                    cout << "Passenger not found" << endl;
-                }
-            }
-            break;
-        case 5:
-            flight1->notify("This is a notification for domestic flight.");
-            flight2->notify("This is a notification for international flight.");
-            break;
-        case 6:
-            {
-                Passenger* new_passenger = add_passenger();
-                if (new_passenger) {
-                    passengers.push_back(new_passenger);
-                    cout << "Passenger added successfully!" << endl;
-                } else {
-                    cout << "Failed to add passenger." << endl;
-                }
-            }
-            break;
-        case 7:
-            {
-                string passport_number;
-                cout << "Enter passport number of the passenger to book flight for: ";
-                cin >> passport_number;
-                Passenger* passenger = nullptr;
-                for (auto* p : passengers) {
-                    if (p->get_passport_number() == passport_number) {
-                        passenger = p;
-                        break;
+                break;
+            case 5:
+                calendar->for_each_flight_of_kind<FlightType::Domestic>([](Flight* flight) {
+                    flight->announce("This is a notification for domestic flight.");
+                });
+                calendar->for_each_flight_of_kind<FlightType::International>([](Flight* flight) {
+                    flight->announce("This is a notification for international flight.");
+                });
+                break;
+            case 6:
+                {
+                    PassengerHandle new_passenger = add_passenger(passengers);
+                    if (new_passenger.is_valid()) {
+                        cout << "Passenger added successfully!" << endl;
+                    } else {
+                        cout << "Failed to add passenger." << endl;
                     }
                 }
-                if (passenger) {
-                    Booking* new_booking = book_flight(passenger, *schedule);
-                    if (new_booking) {
-                        bookings.push_back(new_booking);
-                        itinerary->add_booking(new_booking);
-                        new_booking->confirm_booking();
-                        cout << "Flight booked successfully!" << endl;
+                break;
+            case 7:
+                {
+                    string passport_number;
+                    cout << "Enter passport number of the passenger to book flight for: ";
+                    cin >> passport_number;
+                    PassengerHandle passenger = passengers.find(passport_number);
+                    if (passenger.is_valid()) {
+                        Booking* new_booking = bookings.get(book_flight(bookings, passengers, passenger, *calendar));
+                        if (new_booking) {
+                            itinerary->add_booking(new_booking);
+                            new_booking->confirm_booking();
+                            cout << "Flight booked successfully!" << endl;
+                        } else {
+                            cout << "Failed to book flight." << endl;
+                        }
                     } else {
-                        cout << "Failed to book flight." << endl;
+                        cout << "Passenger not found." << endl;
                     }
-                } else {
-                    cout << "Passenger not found." << endl;
                 }
-            }
-            break;
-        case 8:
-            {
-                string booking_id;
-                cout << "Enter booking ID to cancel: ";
-                cin >> booking_id;
-                bool found = false;
-                for (auto* booking : bookings) {
-                    if (booking->get_booking_id() == booking_id) {
-                        booking->cancel_booking();
-                        itinerary->remove_booking(booking);
-                        bookings.erase(remove(bookings.begin(), bookings.end(), booking), bookings.end());
-                        delete booking;
-                        found = true;
+                break;
+            case 8:
+                {
+                    string booking_id;
+                    cout << "Enter booking ID to cancel: ";
+                    cin >> booking_id;
+                    if (cancel_booking(bookings, booking_id)) {
                         cout << "Booking cancelled successfully!" << endl;
-                        break;
+                    } else {
+                        cout << "Booking not found" << endl;
+                    }
+                }
+                break;
+            case 9:
+                view_passenger_details(passengers);
+                break;
+            case 10:
+                view_flight_details(*calendar);
+                break;
+            case 11:
+                plan_journey(*calendar);
+                break;
+            case 12:
+                view_flights_departing_between(*calendar);
+                break;
+            case 13:
+                save_snapshot(*calendar, passengers, bookings, itineraries, snapshot_path);
+                break;
+            case 14:
+            case 15:
+                {
+                    string path;
+                    cout << "Enter CSV file path: ";
+                    cin >> path;
+                    ImportResult result;
+                    bool imported = choice == 14 ? import_flights_csv(path, *calendar, result)
+                                                 : import_passengers_csv(path, passengers, result);
+                    if (imported) {
+                        print_import_result(result);
+                    } else {
+                        cout << "Cannot read file " << path << endl;
                     }
                 }
-                if (!found) {
-                    cout << "Booking not found" << endl;
+                break;
+            case 16:
+                {
+                    string date;
+                    int32_t first_day;
+                    cout << "Keep days from (YYYY-MM-DD): ";
+                    cin >> date;
+                    if (parse_date(date, first_day)) {
+                        size_t bookings_before = bookings.size();
+                        size_t evicted = calendar->evict_before(first_day, bookings);
+                        cout << "Evicted " << evicted << " days and " << bookings_before - bookings.size() << " bookings" << endl;
+                    } else {
+                        cout << "Invalid date" << endl;
+                    }
                 }
+                break;
+            case 17:
+                print_manifests(*calendar);
+                break;
+            case 18:
+                dump_instrumentation();
+                NotificationDispatcher::instance().get_dispatcher_stats();
+                BookingJournal::instance().get_journal_stats();
+                BookingEngine::instance().get_engine_stats();
+                cout << "Booking totals differing from a full scan: " << verify_booking_totals(*calendar, bookings) << endl;
+                break;
+            case 19:
+                retime_flight(*calendar);
+                break;
+            case 20:
+                cancel_flight(*calendar, bookings);
+                break;
+            case 21:
+                print_booking_totals(*calendar);
+                break;
+            case 22:
+                cout << "Exiting..." << endl;
+                break;
+            default:
+                cout << "Invalid choice. Please try again." << endl;
             }
-            break;
-        case 9:
-            view_passenger_details(passengers);
-            break;
-        case 10:
-            view_flight_details(schedule->get_flights());
-            break;
-        case 11:
-            cout << "Exiting..." << endl;
-            break;
-        default:
-            cout << "Invalid choice. Please try again." << endl;
+        } catch (const JournalException& e) {
+            // Changes can no longer be made durable, so stop taking them
+            cout << e.what() << endl;
+            choice = 22;
         }
-    } while (choice != 11);
+    } while (choice != 22);
+}
 
-    // Clean up dynamically allocated memory
-    for (auto* passenger : passengers) {
-        delete passenger;
+// Start from a snapshot file when one is given on the command line, otherwise from sample data, then replay
+// the booking journal recorded on top of it: <snapshot>.journal, or flight_system.journal for sample data.
+// Then run the menu, or with --serve the request server. --loadgen drives a running server instead.
+//   program [snapshot] [--serve ENDPOINT [--workers N]]
+//   program --loadgen ENDPOINT FLIGHT_NUMBER DATE [CONNECTIONS [SECONDS [DEPTH]]]
+//   program --bench-booking [THREADS [SECONDS]]
+//   program --bench-lookup
+//   program --bench-journey [LEGS [QUERIES]]
+//   program --bench-table [FLIGHTS]
+//   program --bench-snapshot [FLIGHTS [PASSENGERS [PATH_PREFIX]]]
+//   program --bench-journal [THREADS [SECONDS [JOURNAL_PATH]]]
+//   program --bench-fares [FLIGHTS]
+//   program --bench-kinds [FLIGHTS]
+//   program --bench-reports [THREADS [FLIGHTS]]
+//   program --bench-instrumentation [FLIGHTS]
+//   program --check-totals [SEED [STEPS]]
+// An ENDPOINT is a Unix socket path, or tcp:PORT for that port on the loopback interface.
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--loadgen") {
+        if (argc < 5) {
+            cout << "Usage: " << argv[0] << " --loadgen ENDPOINT FLIGHT_NUMBER DATE [CONNECTIONS [SECONDS [DEPTH]]]" << endl;
+            return 1;
+        }
+        return run_loadgen(argv[2], argv[3], argv[4], argc > 5 ? max(1, atoi(argv[5])) : 4, argc > 6 ? max(1, atoi(argv[6])) : 5,
+                           argc > 7 ? max(1, atoi(argv[7])) : 8);
+    }
+    if (argc > 1 && string(argv[1]) == "--check-totals") {
+        return run_check_totals(argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1,
+                                argc > 3 ? max(1, atoi(argv[3])) : 20000);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-lookup") {
+        return run_bench_lookup();
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-journey") {
+        return run_bench_journey(argc > 2 ? max(1, atoi(argv[2])) : 100000, argc > 3 ? max(1, atoi(argv[3])) : 10000);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-table") {
+        return run_bench_table(argc > 2 ? max(1, atoi(argv[2])) : 1000000);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-snapshot") {
+        try {
+            return run_bench_snapshot(argc > 2 ? max(1, atoi(argv[2])) : 200000, argc > 3 ? max(1, atoi(argv[3])) : 200000,
+                                      argc > 4 ? argv[4] : "flight_system_bench");
+        } catch (const SnapshotException& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-journal") {
+        return run_bench_journal(argc > 2 ? max(1, atoi(argv[2])) : 8, argc > 3 ? max(1, atoi(argv[3])) : 2,
+                                 argc > 4 ? argv[4] : "flight_system_bench.journal");
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-fares") {
+        return run_bench_fares(argc > 2 ? max(1, atoi(argv[2])) : 1000000);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-kinds") {
+        return run_bench_kinds(argc > 2 ? max(1, atoi(argv[2])) : 1000000);
     }
-    for (auto* booking : bookings) {
-        delete booking;
+    if (argc > 1 && string(argv[1]) == "--bench-reports") {
+        return run_bench_reports(argc > 2 ? max(1, atoi(argv[2])) : max(1u, thread::hardware_concurrency()),
+                                 argc > 3 ? max(1, atoi(argv[3])) : 5000);
     }
-    for (auto* flight : schedule->get_flights()) {
-        delete flight;
+    if (argc > 1 && string(argv[1]) == "--bench-instrumentation") {
+        return run_bench_instrumentation(argc > 2 ? max(1, atoi(argv[2])) : 500);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-booking") {
+        return run_bench_booking(argc > 2 ? max(1, atoi(argv[2])) : max(1u, thread::hardware_concurrency()),
+                                 argc > 3 ? max(1, atoi(argv[3])) : 2);
     }
-    delete itinerary;
-    delete schedule;
 
-    return 0;
+    string snapshot_path, serve_endpoint;
+    size_t worker_count = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--serve" && i + 1 < argc) {
+            serve_endpoint = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            worker_count = max(1, atoi(argv[++i]));
+        } else if (snapshot_path.empty() && arg.compare(0, 2, "--") != 0) {
+            snapshot_path = arg;
+        } else {
+            cout << "Usage: " << argv[0] << " [snapshot] [--serve ENDPOINT [--workers N]]" << endl;
+            return 1;
+        }
+    }
+    if (!serve_endpoint.empty()) {
+        RequestServer::block_stop_signals();
+    }
+
+    PassengerRegistry passengers;
+    BookingStore bookings;
+    vector<Itinerary*> itineraries;
+    ScheduleCalendar* calendar;
+    int exit_code = 0;
+    string journal_path = (snapshot_path.empty() ? string("flight_system") : snapshot_path) + ".journal";
+    if (!snapshot_path.empty()) {
+        try {
+            SnapshotView snapshot(snapshot_path);
+            calendar = load_snapshot(snapshot, passengers, bookings, itineraries);
+        } catch (const SnapshotException& e) {
+            cout << e.what() << ": " << snapshot_path << endl;
+            return 1;
+        }
+    } else {
+        calendar = create_sample_data(passengers, bookings, itineraries);
+    }
+    JournalReplayResult replay = replay_journal(journal_path, *calendar, passengers, bookings, itineraries);
+    if (replay.records_applied || replay.records_skipped || replay.torn_tail) {
+        cout << "Replayed " << replay.records_applied << " journal records, skipped " << replay.records_skipped
+            << (replay.torn_tail ? ", discarded a torn record at the end" : "") << endl;
+    }
+    if (!BookingJournal::instance().open(journal_path, replay.valid_size)) {
+        cout << "Cannot open booking journal: " << journal_path << endl;
+        return 1;
+    }
+    if (itineraries.empty()) {
+        itineraries.push_back(new Itinerary("I123"));
+    }
+    Itinerary* itinerary = itineraries.front();
+
+    // Print notifications to the console, delivered on a background thread from here on.
+    // A server has no console user, so it discards them.
+    ConsoleSink console_sink;
+    NotificationDispatcher::instance().set_sink(serve_endpoint.empty() ? &console_sink : nullptr);
+    NotificationDispatcher::instance().start();
+
+    if (serve_endpoint.empty()) {
+        run_menu(calendar, passengers, bookings, itineraries, itinerary, snapshot_path);
+    } else {
+        FlightSystem system(*calendar, passengers, bookings, itinerary);
+        RequestServer server(system, worker_count);
+        if (server.listen(serve_endpoint)) {
+            cout << "Serving on " << serve_endpoint << " with " << worker_count << " workers" << endl;
+            server.run();
+            server.get_server_stats();
+            dump_instrumentation();
+        } else {
+            cout << "Cannot listen on " << serve_endpoint << endl;
+            exit_code = 1;
+        }
+    }
+
+    NotificationDispatcher::instance().stop();
+    NotificationDispatcher::instance().set_sink(nullptr);
+    BookingJournal::instance().close();
+
+    // Clean up dynamically allocated memory
+    bookings.clear();
+    for (auto* owned_itinerary : itineraries) {
+        delete owned_itinerary;
+    }
+    delete calendar;
+
+    return exit_code;
 }